@@ -0,0 +1,419 @@
+/*------------------------------------------------------------------------------
+* benchkml.cpp : benchmark of kml converter
+*
+* notes  : the sources of the converter are included in this file, so the
+*          internal stages (static functions) are timed without export. build
+*          and run from the top directory as:
+*
+*              g++ -O2 -Iinclude bench/benchkml.cpp -o benchkml -lpthread
+*              ./benchkml [option ...]
+*
+*          a synthetic solution file is generated by the options and each
+*          stage is run -t times. the best time of stage is reported as
+*          records/s and MB/s (MB of input or output text of stage, "-" for
+*          stages in memory)
+*-----------------------------------------------------------------------------*/
+#include "../src/common.cpp"
+#include "../src/solution.cpp"
+#include "../src/kmz.cpp"
+#include "../src/convKml.cpp"
+
+#define PROGNAME    "benchkml"          /* program name */
+#define MAXQMIX     8                   /* max number of quality in mix */
+#define SORTBLK     1024                /* block of solutions swapped by sort */
+#define SPEED       10.0                /* speed of synthetic rover (m/s) */
+#define QRUN        10.0                /* mean duration of quality (s) */
+#define T0          1610600000.0        /* start time of synthetic file */
+
+/* help text -----------------------------------------------------------------*/
+static const char *help[]={
+"",
+" usage: benchkml [option ...]",
+"",
+" -i file   benchmark existing solution file instead of generated file",
+" -o file   generated solution file [bench.pos]",
+" -r rate   solution rate (Hz) [10]",
+" -d dur    duration (s) [3600]",
+" -q mix    quality mix as q:weight,... [1:70,2:20,5:10]",
+" -n noise  position noise of fixed solution (m) [0.02]",
+" -s seed   random seed [1]",
+" -t n      repeat count of each stage [5]",
+" -g        generate file only",
+" -k        keep generated and output files"
+};
+/* generator options type ----------------------------------------------------*/
+typedef struct {
+    double rate;        /* solution rate (Hz) */
+    double dur;         /* duration (s) */
+    int q[MAXQMIX];     /* quality of mix */
+    double w[MAXQMIX];  /* weight of quality of mix */
+    int nq;             /* number of quality of mix */
+    double noise;       /* position noise of fixed solution (m) */
+} genopt_t;
+
+/* decoded lines of benchmark ------------------------------------------------*/
+typedef struct {
+    const char **line;  /* start of lines */
+    int *len;           /* length of lines */
+    int n;              /* number of lines */
+} lines_t;
+
+static uint64_t rseed=1;
+static volatile int sink=0; /* results of stages kept from optimization */
+
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) {
+        fprintf(stderr,"%s\n",help[i]);
+    }
+    exit(0);
+}
+/* current time (s) ----------------------------------------------------------*/
+static double timenow(void)
+{
+#ifdef WIN32
+    LARGE_INTEGER c,f;
+    QueryPerformanceCounter(&c);
+    QueryPerformanceFrequency(&f);
+    return (double)c.QuadPart/f.QuadPart;
+#else
+    struct timespec tp={0};
+    clock_gettime(CLOCK_MONOTONIC,&tp);
+    return tp.tv_sec+tp.tv_nsec*1E-9;
+#endif
+}
+/* uniform random number in [0,1) (xorshift64*) ------------------------------*/
+static double randu(void)
+{
+    rseed^=rseed>>12; rseed^=rseed<<25; rseed^=rseed>>27;
+    return (double)((rseed*2685821657736338717ULL)>>11)/9007199254740992.0;
+}
+/* normal random number (box-muller) -----------------------------------------*/
+static double randn(void)
+{
+    double u=randu();
+    if (u<=0.0) u=1E-300;
+    return sqrt(-2.0*log(u))*cos(2.0*PI*randu());
+}
+/* decode quality mix ("q:weight,...") ---------------------------------------*/
+static int decodemix(const char *str, genopt_t *gopt)
+{
+    const char *p=str;
+    double sum=0.0;
+    int i,q,n;
+    double w;
+
+    for (gopt->nq=0;*p&&gopt->nq<MAXQMIX;gopt->nq++) {
+        if (sscanf(p,"%d:%lf%n",&q,&w,&n)<2||q<1||q>6||w<0.0) return 0;
+        gopt->q[gopt->nq]=q;
+        gopt->w[gopt->nq]=w;
+        sum+=w;
+        p+=n;
+        if (*p==',') p++;
+    }
+    if (gopt->nq<=0||sum<=0.0) return 0;
+    for (i=0;i<gopt->nq;i++) gopt->w[i]/=sum;
+    return 1;
+}
+/* draw quality by mix -------------------------------------------------------*/
+static int drawq(const genopt_t *gopt)
+{
+    double u=randu(),s=0.0;
+    int i;
+
+    for (i=0;i<gopt->nq-1;i++) {
+        if (u<(s+=gopt->w[i])) break;
+    }
+    return gopt->q[i];
+}
+/* generate synthetic solution file --------------------------------------------
+* generate solution file of rover moving along random curves. the quality
+* changes in runs of mean QRUN s drawn by the mix, and the noise of position
+* and the standard deviations scale by the quality (x1:fix,x10:float,x100:
+* others)
+*-----------------------------------------------------------------------------*/
+static int genpos(const char *file, const genopt_t *gopt)
+{
+    static const double scale[]={0.0,1.0,10.0,100.0,100.0,100.0,100.0};
+    FILE *fp;
+    double dt=1.0/gopt->rate,e=0.0,n=0.0,h=25.0,hdg=0.0,lat0=30.5,lon0=114.3;
+    double sig,lat,lon;
+    int i,q,nep=(int)(gopt->dur*gopt->rate);
+
+    if (!(fp=fopen(file,"w"))) {
+        fprintf(stderr,"file open error : %s\n",file);
+        return 0;
+    }
+    fprintf(fp,"%% program   : %s\n",PROGNAME);
+    fprintf(fp,"%% rate=%.3fHz dur=%.0fs noise=%.4fm\n",gopt->rate,gopt->dur,
+            gopt->noise);
+    q=drawq(gopt);
+
+    for (i=0;i<nep;i++) {
+        if (randu()<dt/QRUN) q=drawq(gopt);
+        hdg+=randn()*0.1*sqrt(dt);
+        e+=SPEED*dt*sin(hdg);
+        n+=SPEED*dt*cos(hdg);
+        h+=randn()*0.05*sqrt(dt);
+        sig=gopt->noise*scale[q];
+        lat=lat0+(n+randn()*sig)/RE_WGS84*R2D;
+        lon=lon0+(e+randn()*sig)/(RE_WGS84*cos(lat0*D2R))*R2D;
+        fprintf(fp,"%.3f  %.9f  %.9f  %.4f  %.4f  %.4f  %.4f  %3d %.1f\n",
+                T0+i*dt,lat,lon,h+randn()*sig*1.5,sig*(0.5+randu()),
+                sig*(0.5+randu()),sig*(1.0+randu()),q,
+                q==1?3.0+randu()*20.0:randu()*3.0);
+    }
+    fclose(fp);
+    return 1;
+}
+/* split lines of mapped file ------------------------------------------------*/
+static int splitlines(const mapfile_t *map, lines_t *lines)
+{
+    const char *p=map->data,*end=map->data+map->size,*q;
+    int nmax=1024;
+
+    lines->n=0;
+    if (!(lines->line=(const char **)malloc(sizeof(char *)*nmax))||
+        !(lines->len=(int *)malloc(sizeof(int)*nmax))) return 0;
+
+    for (;p<end;p=q+1) {
+        if (!(q=(const char *)memchr(p,'\n',end-p))) q=end;
+        if (lines->n>=nmax) {
+            nmax*=2;
+            if (!(lines->line=(const char **)realloc(lines->line,sizeof(char *)*nmax))||
+                !(lines->len=(int *)realloc(lines->len,sizeof(int)*nmax))) return 0;
+        }
+        lines->line[lines->n]=p;
+        lines->len[lines->n++]=(int)(q-p);
+    }
+    return 1;
+}
+/* print result of stage -----------------------------------------------------*/
+static void outresult(const char *stage, double t, int n, double bytes)
+{
+    if (t<=0.0) t=1E-9;
+    if (bytes>0.0) {
+        printf("%-10s %12.3f %14.0f %10.1f\n",stage,t*1E3,n/t,bytes/t/1E6);
+    }
+    else {
+        printf("%-10s %12.3f %14.0f %10s\n",stage,t*1E3,n/t,"-");
+    }
+}
+/* size of file --------------------------------------------------------------*/
+static double filesize(const char *file)
+{
+    struct stat st;
+    return stat(file,&st)?0.0:(double)st.st_size;
+}
+/* benchmark of stages -------------------------------------------------------*/
+static int benchstage(const char *file, int nrep)
+{
+    mapfile_t map;
+    lines_t lines={0};
+    solopt_t opt=solopt_default;
+    solfilt_t filt;
+    solbuf_t sb,sbs;
+    sol_t sol={{0}};
+    outbuf_t ob;
+    timecur_t tc;
+    gtime_t *time,ts={0},te={0};
+    double t,tb,rb[3]={0},pos[3],*r[3],*p[3],bytes;
+    char tmpfile[1024],buff[256],*infile[1],*outfile[1];
+    FILE *fp;
+    int i,j,k,m,q,nsol=0;
+
+    sprintf(tmpfile,"%.1000s.bench.kml",file);
+    if (!openmap(file,&map)) {
+        fprintf(stderr,"file open error : %s\n",file);
+        return 0;
+    }
+    printf("%-10s %12s %14s %10s\n","stage","time(ms)","records/s","MB/s");
+
+    /* line reading */
+    for (k=0,tb=1E9;k<nrep;k++) {
+        const char *q,*end=map.data+map.size;
+        t=timenow();
+        for (q=map.data,m=0;(q=(const char *)memchr(q,'\n',end-q));q++) m++;
+        if ((t=timenow()-t)<tb) tb=t;
+        sink+=m;
+    }
+    if (!splitlines(&map,&lines)) {
+        fprintf(stderr,"memory allocation error\n");
+        closemap(&map);
+        return 0;
+    }
+    outresult("read",tb,lines.n,(double)map.size);
+
+    /* decode_sol */
+    initsolbuf(&sb,0,0);
+    time=(gtime_t *)malloc(sizeof(gtime_t)*(lines.n>0?lines.n:1));
+    for (k=0,tb=1E9;k<nrep;k++) {
+        t=timenow();
+        for (i=nsol=0;i<lines.n;i++) {
+            if (decode_sol(lines.line[i],lines.len[i],&opt,NULL,&sol,rb)==1) {
+                time[nsol++]=sol.time;
+            }
+        }
+        if ((t=timenow()-t)<tb) tb=t;
+    }
+    outresult("decode_sol",tb,lines.n,(double)map.size);
+    for (i=0;i<lines.n;i++) {
+        if (decode_sol(lines.line[i],lines.len[i],&opt,NULL,&sol,rb)==1) {
+            sprintf(buff,"%.*s",lines.len[i]<255?lines.len[i]:255,lines.line[i]);
+            if (sscanf(buff,"%*f %*f %*f %*f %*f %*f %*f %d",&q)==1&&q>=0&&q<=6) {
+                sol.stat=(uint8_t)q; /* flag as quality */
+            }
+            addsol(&sb,&sol);
+        }
+    }
+    /* screent and compiled filter (1 s interval) */
+    if (nsol>0) ts=time[0];
+    for (k=0,tb=1E9;k<nrep;k++) {
+        t=timenow();
+        for (i=m=0;i<nsol;i++) m+=screent(time[i],ts,te,1.0);
+        if ((t=timenow()-t)<tb) tb=t;
+        sink+=m;
+    }
+    outresult("screent",tb,nsol,0.0);
+    initfilt(&filt,ts,te,1.0,0);
+    for (k=0,tb=1E9;k<nrep;k++) {
+        t=timenow();
+        for (i=m=0;i<sb.n;i++) m+=testfilt(&filt,sb.t[i],sb.stat[i]);
+        if ((t=timenow()-t)<tb) tb=t;
+        sink+=m;
+    }
+    outresult("testfilt",tb,sb.n,0.0);
+
+    /* sort_solbuf (blocks of SORTBLK solutions swapped by pairs) */
+    initsolbuf(&sbs,0,0);
+    for (k=0,tb=1E9;k<nrep;k++) {
+        freesolbuf(&sbs);
+        if (!copysolbuf(&sbs,&sb)) break;
+        for (i=0;i+2*SORTBLK<=sbs.n;i+=2*SORTBLK) {
+            for (j=i;j<i+SORTBLK;j++) {
+                int64_t tt=sbs.t[j]; sbs.t[j]=sbs.t[j+SORTBLK]; sbs.t[j+SORTBLK]=tt;
+            }
+        }
+        t=timenow();
+        sort_solbuf(&sbs,NULL,1);
+        if ((t=timenow()-t)<tb) tb=t;
+    }
+    outresult("sort",tb,sb.n,0.0);
+    freesolbuf(&sbs);
+
+    /* ecef2pos (single and batch) */
+    for (i=0;i<3;i++) {
+        r[i]=(double *)malloc(sizeof(double)*(sb.n>0?sb.n:1));
+        p[i]=(double *)malloc(sizeof(double)*(sb.n>0?sb.n:1));
+    }
+    for (i=0;i<sb.n;i++) {
+        for (j=0;j<3;j++) pos[j]=sb.pos[j][i];
+        pos2ecef(pos,rb);
+        for (j=0;j<3;j++) r[j][i]=rb[j];
+    }
+    for (k=0,tb=1E9;k<nrep;k++) {
+        t=timenow();
+        for (i=0;i<sb.n;i++) {
+            rb[0]=r[0][i]; rb[1]=r[1][i]; rb[2]=r[2][i];
+            ecef2pos(rb,pos);
+            p[0][i]=pos[0]; p[1][i]=pos[1]; p[2][i]=pos[2];
+        }
+        if ((t=timenow()-t)<tb) tb=t;
+    }
+    outresult("ecef2pos",tb,sb.n,0.0);
+    for (k=0,tb=1E9;k<nrep;k++) {
+        t=timenow();
+        ecef2posv(r,p,sb.n);
+        if ((t=timenow()-t)<tb) tb=t;
+    }
+    outresult("ecef2posv",tb,sb.n,0.0);
+    for (i=0;i<3;i++) {free(r[i]); free(p[i]);}
+
+    /* outtrack and outpoint */
+    for (k=0,tb=1E9,bytes=0.0;k<nrep;k++) {
+        if (!(fp=fopen(tmpfile,"w"))||!openbuf(&ob,fp,NULL,NULL)) break;
+        t=timenow();
+        outtrack(&ob,&sb,color[3],0,1,0.0,NULL);
+        closebuf(&ob);
+        if ((t=timenow()-t)<tb) tb=t;
+        bytes=(double)ftell(fp);
+        fclose(fp);
+    }
+    outresult("outtrack",tb,sb.n,bytes);
+    for (k=0,tb=1E9,bytes=0.0;k<nrep;k++) {
+        if (!(fp=fopen(tmpfile,"w"))||!openbuf(&ob,fp,NULL,NULL)) break;
+        inittimecur(&tc,TIMES_GPST);
+        t=timenow();
+        for (i=0;i<sb.n;i++) {
+            solpos(&sb,i,NULL,pos);
+            outpoint(&ob,tick2time(sb.t[i]),pos,"",qcolor[sb.stat[i]],0,&tc);
+        }
+        closebuf(&ob);
+        if ((t=timenow()-t)<tb) tb=t;
+        bytes=(double)ftell(fp);
+        fclose(fp);
+    }
+    outresult("outpoint",tb,sb.n,bytes);
+
+    /* end-to-end conversion */
+    infile[0]=(char *)file;
+    outfile[0]=tmpfile;
+    for (k=0,tb=1E9;k<nrep;k++) {
+        t=timenow();
+        sink+=convkmlx(infile,outfile,1,NULL,NULL);
+        if ((t=timenow()-t)<tb) tb=t;
+    }
+    outresult("convkml",tb,sb.n,(double)map.size);
+
+    fprintf(stderr,"%s: %d lines, %d solutions, %.1f MB\n",file,lines.n,sb.n,
+            filesize(file)/1E6);
+    free(time);
+    free(lines.line);
+    free(lines.len);
+    freesolbuf(&sb);
+    closemap(&map);
+    return 1;
+}
+/* benchkml main -------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    genopt_t gopt={10.0,3600.0,{0},{0},0,0.02};
+    const char *infile="",*outfile="bench.pos",*mix="1:70,2:20,5:10";
+    char tmpfile[1024];
+    int i,nrep=5,gen=0,keep=0,stat;
+
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-i")&&i+1<argc) infile=argv[++i];
+        else if (!strcmp(argv[i],"-o")&&i+1<argc) outfile=argv[++i];
+        else if (!strcmp(argv[i],"-r")&&i+1<argc) gopt.rate=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-d")&&i+1<argc) gopt.dur=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-q")&&i+1<argc) mix=argv[++i];
+        else if (!strcmp(argv[i],"-n")&&i+1<argc) gopt.noise=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-s")&&i+1<argc) rseed=strtoull(argv[++i],NULL,10);
+        else if (!strcmp(argv[i],"-t")&&i+1<argc) nrep=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-g")) gen=1;
+        else if (!strcmp(argv[i],"-k")) keep=1;
+        else printhelp();
+    }
+    if (!rseed) rseed=1;
+    if (nrep<1) nrep=1;
+    if (!decodemix(mix,&gopt)||gopt.rate<=0.0||gopt.dur<=0.0) {
+        fprintf(stderr,"invalid option\n");
+        return -1;
+    }
+    if (!*infile) {
+        if (!genpos(outfile,&gopt)) return -1;
+        infile=outfile;
+        if (gen) return 0;
+    }
+    stat=benchstage(infile,nrep);
+
+    if (!keep) {
+        sprintf(tmpfile,"%.1000s.bench.kml",infile);
+        remove(tmpfile);
+        if (infile==outfile) remove(outfile);
+    }
+    return stat?0:-1;
+}
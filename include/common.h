@@ -17,6 +17,33 @@
 #include<cstdint>
 #include<cstdlib>
 
+#ifdef WIN32
+#define thread_t    HANDLE
+#define lock_t      CRITICAL_SECTION
+#define cond_t      CONDITION_VARIABLE
+#define initlock(f) InitializeCriticalSection(f)
+#define lock(f)     EnterCriticalSection(f)
+#define unlock(f)   LeaveCriticalSection(f)
+#define freelock(f) DeleteCriticalSection(f)
+#define initcond(c) InitializeConditionVariable(c)
+#define waitcond(c,f) SleepConditionVariableCS(c,f,INFINITE)
+#define signalcond(c) WakeConditionVariable(c)
+#define broadcastcond(c) WakeAllConditionVariable(c)
+#define freecond(c)
+#else
+#define thread_t    pthread_t
+#define lock_t      pthread_mutex_t
+#define cond_t      pthread_cond_t
+#define initlock(f) pthread_mutex_init(f,NULL)
+#define lock(f)     pthread_mutex_lock(f)
+#define unlock(f)   pthread_mutex_unlock(f)
+#define freelock(f) pthread_mutex_destroy(f)
+#define initcond(c) pthread_cond_init(c,NULL)
+#define waitcond(c,f) pthread_cond_wait(c,f)
+#define signalcond(c) pthread_cond_signal(c)
+#define broadcastcond(c) pthread_cond_broadcast(c)
+#define freecond(c) pthread_cond_destroy(c)
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -46,6 +73,20 @@ extern "C" {
 #define TIMES_UTC   1                   /* time system: utc */
 #define TIMES_JST   2                   /* time system: jst */
 
+#define TICKS       16777216.0          /* time ticks per second (2^24) */
+#define MAXKMZBLK   (1<<18)             /* max size of kml block to compress */
+#define NKMZTHREAD  4                   /* number of compression threads of kmz */
+#define NKMZJOB     (NKMZTHREAD*2)      /* number of blocks queued to compress */
+#define MAXARENASOL (1<<30)             /* max number of solutions in arena */
+#define ARENASEG    (2<<20)             /* size of arena segment (bytes) */
+#define ARENAKEEP   (8<<20)             /* max size kept committed in arena column after use (bytes) */
+
+#define STG_READ    0                   /* stage: read solutions */
+#define STG_SORT    1                   /* stage: sort solutions */
+#define STG_WRITE   2                   /* stage: write kml */
+#define STG_TOTAL   3                   /* stage: total of conversion */
+#define NSTAGE      4                   /* number of stages */
+
 #define COMMENTH    "%"                 /* comment line indicator for solution */
 #define MSG_DISCONN "$_DISCONNECT\r\n"  /* disconnect message */
 
@@ -55,16 +96,28 @@ typedef struct {        /* time struct */
     double sec;         /* fraction of second under 1 s */
 }gtime_t;
 
+typedef struct {        /* time conversion cursor type */
+    int sys;            /* time system (TIMES_???) */
+    gtime_t tb[MAXLEAPS]; /* leap second boundaries (gpst) */
+    int nb;             /* number of leap second boundaries */
+    gtime_t ts,te;      /* interval of current leap seconds (gpst) */
+    double leap;        /* current leap seconds (utc-gpst) (s) */
+    int valid;          /* current day set (0:no,1:yes) */
+    int days;           /* current day (days since 1970/1/1) */
+    double ep[3];       /* date of current day {year,month,day} */
+} timecur_t;
+
 typedef struct {        /* solution type */
     gtime_t time;       /* time (GPST) */
     double rr[6];       /* position/velocity (m|m/s) */
-                        /* {x,y,z,vx,vy,vz} or {e,n,u,ve,vn,vu} */
+                        /* {x,y,z,vx,vy,vz} or {e,n,u,ve,vn,vu} or */
+                        /* {lat,lon,h,vx,vy,vz} (position: rad,m) */
     float  qr[6];       /* position variance/covariance (m^2) */
                         /* {c_xx,c_yy,c_zz,c_xy,c_yz,c_zx} or */
                         /* {c_ee,c_nn,c_uu,c_en,c_nu,c_ue} */
     float  qv[6];       /* velocity variance/covariance (m^2/s^2) */
     double dtr[6];      /* receiver clock bias to time systems (s) */
-    uint8_t type;       /* type (0:xyz-ecef,1:enu-baseline) */
+    uint8_t type;       /* type (0:xyz-ecef,1:enu-baseline,2:llh-geodetic) */
     uint8_t stat;       /* solution status (SOLQ_???) */
     uint8_t ns;         /* number of valid satellites */
     float age;          /* age of differential (s) */
@@ -72,17 +125,68 @@ typedef struct {        /* solution type */
     float thres;        /* AR ratio threshold for valiation */
 } sol_t;
 
+typedef struct {        /* solution extra data type */
+    double rr[3];       /* velocity {vx,vy,vz} or {ve,vn,vu} (m/s) */
+    float  qr[6];       /* position variance/covariance (m^2) */
+    float  qv[6];       /* velocity variance/covariance (m^2/s^2) */
+    double dtr[6];      /* receiver clock bias to time systems (s) */
+    uint8_t type;       /* position column (0:llh-geodetic,1:enu-baseline) */
+    uint8_t ns;         /* number of valid satellites */
+    float age;          /* age of differential (s) */
+    float ratio;        /* AR ratio factor for valiation */
+    float thres;        /* AR ratio threshold for valiation */
+} solext_t;
+
+typedef struct {        /* memory arena type */
+    char *base;         /* base of reserved address space (NULL:none) */
+    size_t size;        /* size of reserved address space (bytes) */
+    size_t used;        /* size of committed segments (bytes) */
+    int huge;           /* backed by huge pages (0:off,1:on) */
+} arena_t;
+
+typedef struct {        /* arena of solution columns type */
+    arena_t col[6];     /* columns {t,lat,lon,h,stat,ext} */
+    int inuse;          /* used by a solution buffer (0:no,1:yes) */
+} solarena_t;
+
+typedef struct {        /* compensated sum of positions type */
+    double sum[3];      /* sum of ecef positions {x,y,z} (m) */
+    double comp[3];     /* compensation of rounding errors of sum (m) */
+    int64_t n;          /* number of positions */
+} possum_t;
+
+typedef struct {        /* compiled solution filter type */
+    int64_t ts,te;      /* start/end time (ticks) (ts<=t<te) */
+    int64_t tint;       /* time interval (ticks) (0:all,-1:by screent()) */
+    int64_t tol;        /* tolerance of time interval (ticks) */
+    int64_t t0;         /* gps time reference (ticks) */
+    double dint;        /* time interval (s) */
+    int qflag;          /* quality flag (0:all) */
+    gtime_t gts,gte;    /* start/end time compiled */
+    int valid;          /* compiled (0:no,1:yes) */
+} solfilt_t;
+
 typedef struct {        /* solution buffer type */
     int n,nmax;         /* number of solution/max number of buffer */
     int cyclic;         /* cyclic buffer flag */
     int start,end;      /* start/end index */
     gtime_t time;       /* current solution time */
-    sol_t *data;        /* solution data */
+    int64_t *t;         /* time column (GPST) (TICKS since 1970/1/1) */
+    double *pos[3];     /* position columns {lat,lon,h} (rad,m) */
+                        /* ({e,n,u} (m) for enu-baseline) */
+    uint8_t *stat;      /* solution status column (SOLQ_???) */
+    solext_t *ext;      /* extra data column (NULL: none added) */
+    solarena_t *arena;  /* arena of columns (NULL: heap by realloc) */
+    int ngrow;          /* number of growth of columns */
+    int summ;           /* sum positions while added (0:off,1:on) */
+    int nsum;           /* number of solutions summed to psum */
+    possum_t psum;      /* sum of positions for mean position */
+    solfilt_t filt;     /* filter compiled by inputsol() */
+    sol_t sol;          /* solution returned by getsol() */
     double rb[3];       /* reference position {x,y,z} (ecef) (m) */
     uint8_t buff[MAXSOLMSG+1]; /* message buffer */
     int nb;             /* number of byte in message buffer */
-} solbuf_t;
-
+} solbuf_t;             /* 33 bytes/solution (+112 with ext) vs 176 of sol_t */
 
 typedef struct {        /* solution options type */
     int posf;           /* solution format (SOLF_???) */
@@ -106,6 +210,46 @@ typedef struct {        /* solution options type */
     double maxsolstd;   /* max std-dev for solution output (m) (0:all) */
 } solopt_t;
 
+typedef struct {        /* conversion statistics type */
+    double wall[NSTAGE]; /* wall time of stages (s) (STG_???) */
+    double cpu[NSTAGE]; /* cpu time of stages by calling thread (s) */
+    uint64_t bytein;    /* bytes of input read */
+    uint64_t byteout;   /* bytes of output written */
+    int64_t nline;      /* number of lines read */
+    int64_t nsol;       /* number of solutions kept */
+    int64_t nscr;       /* number of solutions screened out by time/qflag */
+    int64_t nerr;       /* number of invalid lines */
+    int ngrow;          /* number of growth of solution columns */
+    double memcol;      /* peak memory of solution columns (bytes) */
+    double maxrss;      /* peak resident memory of process (bytes) */
+} convstat_t;
+
+typedef struct {        /* reusable buffers of solution reader type */
+    char *buff;         /* block buffer of file read (NULL: not allocated) */
+    void *job;          /* parse jobs with private solution buffers (rdjob_t) */
+    int njob;           /* number of parse jobs allocated */
+} solrdbuf_t;
+
+typedef struct {        /* solution read options type */
+    int mmap;           /* read file via memory mapping (0:off,1:on) */
+    int nthread;        /* number of parse threads per mapped file */
+    int cache;          /* binary solution cache <file>.solc (0:off,1:on) */
+    int index;          /* time index <file>.soli for ts/te (0:off,1:on) */
+    solarena_t *arena;  /* arena of solution columns (NULL: heap) */
+    convstat_t *stat;   /* statistics of reading added (NULL: off) */
+    int mean;           /* sum positions for solmean() while read (0:off,1:on) */
+    solrdbuf_t *rdbuf;  /* buffers of reader reused with solution buffer */
+                        /* (NULL: allocated per file) */
+} rdopt_t;
+
+typedef struct {        /* memory mapped file type */
+    const char *data;   /* mapped data */
+    size_t size;        /* size of data (bytes) */
+#ifdef WIN32
+    HANDLE file,mapping; /* file/mapping handle */
+#endif
+} mapfile_t;
+
 typedef struct {        /* solution status type */
     gtime_t time;       /* time (GPST) */
     uint8_t sat;        /* satellite number */
@@ -126,15 +270,59 @@ typedef struct {        /* solution status buffer type */
     solstat_t *data;    /* solution status data */
 } solstatbuf_t;
 
+typedef struct {        /* kmz compression job type */
+    uint8_t *win;       /* dictionary (end of previous block) + block */
+    int ndict,nblk;     /* number of bytes of dictionary/block */
+    int *head,*prev;    /* hash chains */
+    uint8_t *out;       /* compressed data */
+    int nout;           /* number of bytes of compressed data */
+    uint64_t bitbuf;    /* bit buffer */
+    int nbit;           /* number of bits in bit buffer */
+    uint32_t crc;       /* crc-32 of block */
+    int done;           /* compression done (0:no,1:yes) */
+} kmzjob_t;
+
+typedef struct {        /* kmz writer type */
+    FILE *fp;           /* output file */
+    char name[256];     /* name of kml in archive */
+    uint16_t dostime,dosdate; /* modification time/date (ms-dos) */
+    uint32_t crc;       /* crc-32 of kml */
+    uint64_t usize,csize; /* uncompressed/compressed size (bytes) */
+    uint64_t offset;    /* offset of compressed data (bytes) */
+    uint16_t hcode[288]; /* fixed huffman codes of literal/length (lsb first) */
+    uint8_t hlen[288];  /* lengths of fixed huffman codes (bits) */
+    uint8_t lsym[256];  /* length code of match length-3 */
+    uint8_t dsym[512];  /* distance code by index of distance (see distsym()) */
+    uint8_t dcode[30];  /* 5 bits codes of distance codes (lsb first) */
+    uint32_t crctbl[8][256]; /* crc-32 tables of slicing by 8 bytes */
+    kmzjob_t job[NKMZJOB]; /* jobs of blocks (ring by sequence number) */
+    int nsub,nexe,nwrt; /* number of jobs submitted/started/written */
+    int stop;           /* stop request of compression threads */
+    int stat;           /* status (1:ok,0:write error) */
+    int nthread;        /* number of compression threads (0:no thread) */
+    thread_t thread[NKMZTHREAD]; /* compression threads */
+    lock_t lock;        /* lock flag */
+    cond_t cond;        /* condition of job submitted/done */
+} kmz_t;
+
 extern const solopt_t solopt_default;
+extern const rdopt_t rdopt_default;
 
 extern gtime_t gpst2utc(gtime_t t);
 extern void time2epoch(gtime_t t, double *ep);
+extern void inittimecur(timecur_t *tc, int sys);
+extern void timecur2epoch(timecur_t *tc, gtime_t t, double *ep);
 
 extern gtime_t timeadd(gtime_t t, double sec);
 extern double timediff(gtime_t t1, gtime_t t2);
 
 extern gtime_t epoch2time(const double *ep);
+extern int64_t time2tick(gtime_t t);
+extern gtime_t tick2time(int64_t tick);
+extern uint32_t tickget(void);
+extern void sleepms(int ms);
+extern void proctime(double *t);
+extern double peakmem(void);
 
 extern void ecef2pos(const double *r, double *pos);
 extern double dot(const double *a, const double *b, int n);
@@ -146,17 +334,63 @@ extern void matmul(const char *tr, int n, int k, int m, double alpha,
                    const double *A, const double *B, double beta, double *C);
 
 
-extern int readsolt(char *files, int nfile, gtime_t ts, gtime_t te,
+extern int readsolt(char *files[], int nfile, gtime_t ts, gtime_t te,
     double tint, int qflag, solbuf_t *solbuf);
+extern int readsoltx(char *files[], int nfile, gtime_t ts, gtime_t te,
+    double tint, int qflag, const rdopt_t *ropt, solbuf_t *solbuf);
+extern int readsolcb(char *file, gtime_t ts, gtime_t te, double tint,
+    int qflag, const rdopt_t *ropt, int (*func)(const sol_t *, void *),
+    void *arg);
+extern int inputsol(uint8_t data, gtime_t ts, gtime_t te, double tint,
+    int qflag, const solopt_t *opt, solbuf_t *solbuf);
+extern int srchash(FILE *fp, uint64_t size, uint64_t *hash);
+extern int readsolcbx(char *file, int64_t *range, int *line, gtime_t ts,
+    gtime_t te, double tint, int qflag, const rdopt_t *ropt,
+    int (*func)(const sol_t *, void *), void *arg);
+
+extern int initarena(arena_t *arena, size_t size, int huge);
+extern void *growarena(arena_t *arena, size_t size);
+extern void trimarena(arena_t *arena, size_t size);
+extern void freearena(arena_t *arena);
+extern int initsolarena(solarena_t *arena, int huge);
+extern void freesolarena(solarena_t *arena);
+extern size_t solarenamem(const solarena_t *arena);
+
+extern int openmap(const char *file, mapfile_t *map);
+extern void closemap(mapfile_t *map);
+extern int fseekoff(FILE *fp, int64_t off, int origin);
+extern int64_t ftelloff(FILE *fp);
+extern int ftruncoff(FILE *fp, int64_t size);
+
+extern int openkmz(kmz_t *kmz, FILE *fp, const char *name);
+extern int writekmz(kmz_t *kmz, const char *buff, int n);
+extern int closekmz(kmz_t *kmz);
 
 
 extern double time2gpst(gtime_t t, int *week);
 extern int screent(gtime_t time, gtime_t ts, gtime_t te, double tint);
 extern void covecef(const double *pos, const double *Q, double *P);
 extern int addsol(solbuf_t *solbuf, const sol_t *sol);
+extern sol_t *getsol(solbuf_t *solbuf, int index);
 extern void initsolbuf(solbuf_t *solbuf, int cyclic, int nmax);
+extern void clearsolbuf(solbuf_t *solbuf);
+extern size_t solbufmem(const solbuf_t *solbuf);
+extern int solmean(solbuf_t *solbuf, double *rr);
+extern int copysolbuf(solbuf_t *dst, const solbuf_t *src);
 extern void pos2ecef(const double *pos, double *r);
+extern void pos2ecefv(double *const *pos, double *const *r, int n);
+extern void ecef2posv(double *const *r, double *const *pos, int n);
+extern void addpossum(possum_t *ps, double *const *r, int n);
+extern void mergepossum(possum_t *ps, const possum_t *src);
+extern int meanpossum(const possum_t *ps, double *rr);
+extern void enu2ecefv(double *const *pos, double *const *e, double *const *r,
+                      int n);
+extern void ecef2enuv(double *const *pos, double *const *r, double *const *e,
+                      int n);
 extern void freesolbuf(solbuf_t *solbuf);
+extern void initrdbuf(solrdbuf_t *rdbuf);
+extern void freerdbuf(solrdbuf_t *rdbuf);
+extern size_t rdbufmem(const solrdbuf_t *rdbuf);
 
 #ifdef __cplusplus
 }
@@ -4,11 +4,57 @@
 
 #include"common.h"
 
-
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {        /* kml conversion options type */
+    gtime_t ts,te;      /* start/end time (gpst) (time==0:no limit) */
+    double tint;        /* time interval (s) (0.0:all) */
+    int qflg;           /* quality flag (0:all) */
+    double offset[3];   /* add offset {east,north,up} (m) */
+    int tcolor;         /* track color (0:none,1:white,2:green,3:orange,4:red,5:yellow) */
+    int pcolor;         /* point color (0:none,1:white,2:green,3:orange,4:red,5:by qflag) */
+    int outalt;         /* output altitude (0:off,1:elipsoidal,2:geodetic) */
+    int outtime;        /* output time (0:off,1:gpst,2:utc,3:jst) */
+    int nthread;        /* number of worker threads (files converted in parallel) */
+    double maxmem;      /* memory budget of files in process (MB) (0:no limit) */
+    rdopt_t ropt;       /* solution read options */
+    int stream;         /* streaming conversion in constant memory (0:off,1:on) */
+    double tsimp;       /* tolerance of track simplification (m) (0.0:off) */
+    int tile;           /* tiled points by quadtree (0:off,n:max level) */
+    int kmz;            /* output kmz (0:kml,1:kmz compressed in background) */
+    int append;         /* append new lines of growing file (0:off,1:on) */
+    int arena;          /* solution columns in arena (0:off,1:on,2:on with huge pages) */
+    int stats;          /* output statistics to <outfile>.json (0:off,1:on) */
+} kmlopt_t;
+
+typedef struct {        /* kml converter type */
+    kmlopt_t opt;       /* conversion options */
+    char *buff;         /* output buffer (NULL: allocated per file) */
+    solbuf_t solbuf;    /* solution buffer cleared and reused per file */
+    solrdbuf_t rdbuf;   /* buffers of solution reader reused per file */
+    solarena_t arena;   /* arena of solution columns */
+    int aren;           /* arena reserved (0:no,1:yes) */
+} kmlconv_t;
+
+extern const kmlopt_t kmlopt_default;
 
 extern int convkml(char *infile[], char *outfile[], gtime_t ts,
     gtime_t te, int nfile, double tint, int qflg, double *offset,
     int tcolor, int pcolor, int outalt, int outtime);
+extern int convkmlx(char *infile[], char *outfile[], int nfile,
+    const kmlopt_t *opt, int *stat);
+extern int initkmlconv(kmlconv_t *conv, const kmlopt_t *opt);
+extern void freekmlconv(kmlconv_t *conv);
+extern int convkmlfile(kmlconv_t *conv, const char *infile,
+    const char *outfile);
+extern int convkmllive(const char *path, const char *file, int nmax,
+    double intv, const kmlopt_t *opt);
+
+#ifdef __cplusplus
+}
+#endif
 
 
 
@@ -1,7 +1,6 @@
 
 
 #include"./include/convKml.h"
-#include<iostream>
 
 int main(int argc,char *argv[]) {
 
@@ -15,28 +14,13 @@ int main(int argc,char *argv[]) {
     int outtime = 1;
     int nfile = 0;
 
-    char  *infile[1024];
+    char **infile = argv + 1; /* input files by arguments */
 
-    for (int i = 0;i<MAXEXFILE;i++) {
-        if (!(infile[i] = (char *)malloc(1024))) {
-            for (i--;i >= 0;i--) free(infile[i]);
-            return -4;
-        }
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s file ...\n", argv[0]);
+        return -1;
     }
-
-    std::cout <<0<< argv[0] << std::endl;
-    std::cout <<1<< argv[1] << std::endl;
-    std::cout <<2<< argv[2] << std::endl;
-    std::cout << argc << std::endl;
-    for (int i = 1;i < argc;i++) {
-        strcpy(infile[i-1], argv[i]);
-        std::cout << infile[i-1] << std::endl;
-    }
-
-
-    std::cout << argc - 1 << std::endl;
     nfile = argc - 1;
-    system("pause");
 
    /* nfile = argc-1;
     std::cout << nfile << std::endl;
@@ -53,14 +37,8 @@ int main(int argc,char *argv[]) {
     };*/
 
     int stat= convkml(infile, NULL, ts,
-        te, 2,tint, qflg, offset,
+        te, nfile,tint, qflg, offset,
         tcolor,  pcolor,  outalt, outtime);
 
-    for (int i = 0;i<MAXEXFILE;i++) {
-        free(infile[i]);
-    }
-
-    system("pause");
-
-    return 0;
+    return stat;
 }
\ No newline at end of file
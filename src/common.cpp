@@ -1,5 +1,6 @@
 
 
+#define _FILE_OFFSET_BITS 64            /* 64-bit off_t of fseeko()/ftruncate() */
 #include "../include/common.h"
 #include <cmath>
 
@@ -13,6 +14,13 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <io.h>             /* _chsize_s() */
+#include <psapi.h>          /* GetProcessMemoryInfo() (kernel32 on win7+) */
 #endif
 
 const solopt_t solopt_default={ /* defaults solution output options */
@@ -24,6 +32,15 @@ const solopt_t solopt_default={ /* defaults solution output options */
 };
 
 
+#define NVBLK       256                 /* block size of batch kernels */
+
+#if defined(__GNUC__)&&!defined(__clang__)&&defined(__x86_64__)&&!defined(WIN32)
+#define VKERNEL __attribute__((target_clones("avx512f","avx2","default"), \
+                                optimize("fp-contract=off"))) /* no fma */
+#else
+#define VKERNEL
+#endif
+
 static const double gpst0[]={1980,1, 6,0,0,0}; /* gps time reference */
 static const double gst0 []={1999,8,22,0,0,0}; /* galileo system time reference */
 static const double bdt0 []={2006,1, 1,0,0,0}; /* beidou time reference */
@@ -88,6 +105,88 @@ extern gtime_t gpst2utc(gtime_t t)
     return t;
 }
 
+/* initialize time conversion cursor -------------------------------------------
+* initialize cursor to convert gpst to calendar day/time in a time system
+* args   : timecur_t *tc    O   time conversion cursor
+*          int    sys       I   time system (TIMES_GPST,TIMES_UTC,TIMES_JST)
+* return : none
+* notes  : the leap second boundaries are precomputed in gpst, so that
+*          t>=tb[i] is same as the condition of gpst2utc() for t+leaps[i]
+*-----------------------------------------------------------------------------*/
+extern void inittimecur(timecur_t *tc, int sys)
+{
+    int i;
+    
+    tc->sys=sys;
+    for (i=0;leaps[i][0]>0;i++) {
+        tc->tb[i]=timeadd(epoch2time(leaps[i]),-leaps[i][6]);
+    }
+    tc->nb=i;
+    tc->ts.time=tc->te.time=0; /* no interval of leap seconds */
+    tc->ts.sec=tc->te.sec=0.0;
+    tc->leap=0.0;
+    tc->valid=0; /* no current day */
+    tc->days=0;
+    tc->ep[0]=tc->ep[1]=tc->ep[2]=0.0;
+}
+/* set leap seconds of cursor ------------------------------------------------*/
+static void setleapcur(timecur_t *tc, gtime_t t)
+{
+    gtime_t t0={0},t1={(time_t)4102444800LL,0.0}; /* 1970/1/1,2100/1/1 */
+    int i;
+    
+    for (i=0;i<tc->nb;i++) {
+        if (timediff(t,tc->tb[i])>=0.0) break;
+    }
+    tc->leap=i<tc->nb?leaps[i][6]:0.0;
+    tc->ts=i<tc->nb?tc->tb[i]:t0;
+    tc->te=i>0?tc->tb[i-1]:t1;
+}
+/* convert time to calendar day/time by cursor ---------------------------------
+* convert gtime_t struct in gpst to calendar day/time in the time system of
+* cursor. same as time2epoch() after gpst2utc() (and +9hr for jst)
+* args   : timecur_t *tc    IO  time conversion cursor
+*          gtime_t t        I   gtime_t struct (gpst)
+*          double *ep       O   day/time {year,month,day,hour,min,sec}
+* return : none
+* notes  : leap seconds are searched only if t is out of the interval of last
+*          leap seconds and the date is carried forward from the day of last
+*          call, so time2epoch() is called only on a jump of time
+*-----------------------------------------------------------------------------*/
+extern void timecur2epoch(timecur_t *tc, gtime_t t, double *ep)
+{
+    const int mday[]={31,28,31,30,31,30,31,31,30,31,30,31};
+    int days,sec,n;
+    
+    if (tc->sys!=TIMES_GPST) {
+        if (timediff(t,tc->ts)<0.0||timediff(t,tc->te)>=0.0) setleapcur(tc,t);
+        if (tc->leap!=0.0) t=timeadd(t,tc->leap);
+        if (tc->sys==TIMES_JST) t=timeadd(t,9*3600.0);
+    }
+    days=(int)(t.time/86400);
+    sec=(int)(t.time-(time_t)days*86400);
+    
+    if (tc->valid&&days==tc->days+1) { /* next day */
+        n=mday[(int)tc->ep[1]-1]+((int)tc->ep[1]==2&&(int)tc->ep[0]%4==0?1:0);
+        if (++tc->ep[2]>n) {
+            tc->ep[2]=1;
+            if (++tc->ep[1]>12) {
+                tc->ep[1]=1;
+                tc->ep[0]++;
+            }
+        }
+        tc->days=days;
+    }
+    else if (!tc->valid||days!=tc->days) {
+        time2epoch(t,ep);
+        tc->ep[0]=ep[0]; tc->ep[1]=ep[1]; tc->ep[2]=ep[2];
+        tc->days=days;
+        tc->valid=1;
+    }
+    ep[0]=tc->ep[0]; ep[1]=tc->ep[1]; ep[2]=tc->ep[2];
+    ep[3]=sec/3600; ep[4]=sec%3600/60; ep[5]=sec%60+t.sec;
+}
+
 /* add time --------------------------------------------------------------------
 * add time to gtime_t struct
 * args   : gtime_t t        I   gtime_t struct
@@ -135,6 +234,126 @@ extern gtime_t epoch2time(const double *ep)
 }
 
 
+/* time to ticks ---------------------------------------------------------------
+* convert gtime_t struct to integer ticks
+* args   : gtime_t t        I   gtime_t struct
+* return : time in ticks (1/TICKS s) since 1970/1/1
+* notes  : TICKS=2^24, so ticks hold fraction of second of a double time in
+*          seconds since 1970 (precision 2^-24 s or coarser after 1978)
+*          exactly and tick2time(time2tick(t)) returns same t
+*-----------------------------------------------------------------------------*/
+extern int64_t time2tick(gtime_t t)
+{
+    return (int64_t)t.time*(int64_t)TICKS+(int64_t)floor(t.sec*TICKS+0.5);
+}
+/* ticks to time ---------------------------------------------------------------
+* convert integer ticks to gtime_t struct
+* args   : int64_t tick     I   time in ticks (1/TICKS s) since 1970/1/1
+* return : gtime_t struct
+*-----------------------------------------------------------------------------*/
+extern gtime_t tick2time(int64_t tick)
+{
+    gtime_t t;
+    int64_t sec=tick/(int64_t)TICKS;
+    
+    if (sec*(int64_t)TICKS>tick) sec--; /* floor for negative ticks */
+    t.time=(time_t)sec;
+    t.sec=(double)(tick-sec*(int64_t)TICKS)/TICKS;
+    return t;
+}
+/* get tick time ---------------------------------------------------------------
+* get current tick in ms
+* args   : none
+* return : current tick in ms
+*-----------------------------------------------------------------------------*/
+extern uint32_t tickget(void)
+{
+#ifdef WIN32
+    return (uint32_t)GetTickCount();
+#else
+    struct timespec tp={0};
+    struct timeval  tv={0};
+    
+    if (!clock_gettime(CLOCK_MONOTONIC,&tp)) {
+        return tp.tv_sec*1000u+tp.tv_nsec/1000000u;
+    }
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec*1000u+tv.tv_usec/1000u;
+#endif
+}
+/* sleep ms --------------------------------------------------------------------
+* sleep ms
+* args   : int   ms         I   miliseconds to sleep (<0:no sleep)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void sleepms(int ms)
+{
+#ifdef WIN32
+    if (ms<5) Sleep(1); else Sleep(ms);
+#else
+    struct timespec ts;
+    if (ms<=0) return;
+    ts.tv_sec=(time_t)(ms/1000);
+    ts.tv_nsec=(long)(ms%1000*1000000);
+    nanosleep(&ts,NULL);
+#endif
+}
+/* get process time ------------------------------------------------------------
+* get wall time and cpu time of calling thread
+* args   : double *t        O   {wall time,cpu time} (s)
+* return : none
+* notes  : for differences of time. cpu time of other threads is not included
+*-----------------------------------------------------------------------------*/
+extern void proctime(double *t)
+{
+#ifdef WIN32
+    LARGE_INTEGER c,f;
+    FILETIME tc,te,tk,tu;
+    
+    QueryPerformanceCounter(&c);
+    QueryPerformanceFrequency(&f);
+    t[0]=(double)c.QuadPart/f.QuadPart;
+    t[1]=0.0;
+    if (GetThreadTimes(GetCurrentThread(),&tc,&te,&tk,&tu)) {
+        t[1]=((double)tk.dwLowDateTime+tk.dwHighDateTime*4294967296.0+
+              (double)tu.dwLowDateTime+tu.dwHighDateTime*4294967296.0)*1E-7;
+    }
+#else
+    struct timespec tp={0};
+    
+    clock_gettime(CLOCK_MONOTONIC,&tp);
+    t[0]=tp.tv_sec+tp.tv_nsec*1E-9;
+    t[1]=0.0;
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID,&tp)) {
+        t[1]=tp.tv_sec+tp.tv_nsec*1E-9;
+    }
+#endif
+}
+/* get peak memory -------------------------------------------------------------
+* get peak resident memory of process
+* args   : none
+* return : peak resident memory (bytes) (0.0: unknown)
+*-----------------------------------------------------------------------------*/
+extern double peakmem(void)
+{
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    
+    pmc.cb=sizeof(pmc);
+    if (!GetProcessMemoryInfo(GetCurrentProcess(),&pmc,sizeof(pmc))) return 0.0;
+    return (double)pmc.PeakWorkingSetSize;
+#else
+    struct rusage ru;
+    
+    if (getrusage(RUSAGE_SELF,&ru)) return 0.0;
+#ifdef __APPLE__
+    return (double)ru.ru_maxrss; /* bytes */
+#else
+    return ru.ru_maxrss*1024.0; /* kbytes */
+#endif
+#endif
+}
+
 /* transform ecef to geodetic postion ------------------------------------------
 * transform ecef position to geodetic position
 * args   : double *r        I   ecef position {x,y,z} (m)
@@ -289,4 +508,461 @@ extern void pos2ecef(const double *pos, double *r)
     r[0] = (v + pos[2])*cosp*cosl;
     r[1] = (v + pos[2])*cosp*sinl;
     r[2] = (v*(1.0 - e2) + pos[2])*sinp;
-}
\ No newline at end of file
+}
+/* batch kernels of coordinate transformation ----------------------------------
+* the arithmetic of the batch transformations is done by the kernels below on
+* blocks of NVBLK points. the loops have no branch and no call, so compilers
+* vectorize them. with gcc on x86 the kernels are cloned for avx512f/avx2 and
+* the clone is selected at runtime by the cpu. transcendental functions are
+* called per point out of the kernels, so the results are bit-identical to
+* the scalar transformation on any cpu unless the compiler contracts to fma
+* (e.g. -march=native). see test/testtrans.cpp for the accuracy
+*-----------------------------------------------------------------------------*/
+static VKERNEL void pos2ecefk(const double *sinp, const double *cosp,
+                              const double *sinl, const double *cosl,
+                              const double *h, double *x, double *y, double *z,
+                              int n)
+{
+    double e2=FE_WGS84*(2.0-FE_WGS84),v;
+    int i;
+    
+    for (i=0;i<n;i++) {
+        v=RE_WGS84/sqrt(1.0-e2*sinp[i]*sinp[i]);
+        x[i]=(v+h[i])*cosp[i]*cosl[i];
+        y[i]=(v+h[i])*cosp[i]*sinl[i];
+        z[i]=(v*(1.0-e2)+h[i])*sinp[i];
+    }
+}
+static VKERNEL void ecef2posk1(const double *x, const double *y,
+                               const double *z, double *r2, double *q,
+                               double *rt, double *a, int n)
+{
+    const double a2=RE_WGS84*RE_WGS84,e2=FE_WGS84*(2.0-FE_WGS84),e4=e2*e2;
+    double p,s;
+    int i;
+    
+    for (i=0;i<n;i++) {
+        r2[i]=x[i]*x[i]+y[i]*y[i];
+        p=r2[i]/a2;
+        q[i]=(1.0-e2)/a2*z[i]*z[i];
+        rt[i]=(p+q[i]-e4)/6.0;
+        s=e4*p*q[i]/(4.0*rt[i]*rt[i]*rt[i]);
+        a[i]=1.0+s+sqrt(s*(2.0+s));
+    }
+}
+static VKERNEL void ecef2posk2(const double *z, const double *r2,
+                               const double *q, const double *rt,
+                               const double *t, double *d, double *h, int n)
+{
+    const double e2=FE_WGS84*(2.0-FE_WGS84),e4=e2*e2;
+    double u,v,w,k,dd,tt;
+    int i;
+    
+    for (i=0;i<n;i++) {
+        u=rt[i]*(1.0+t[i]+1.0/t[i]);
+        v=sqrt(u*u+e4*q[i]);
+        w=e2*(u+v-q[i])/(2.0*v);
+        k=sqrt(u+v+w*w)-w;
+        dd=k*sqrt(r2[i])/(k+e2);
+        tt=sqrt(dd*dd+z[i]*z[i]);
+        d[i]=dd+tt;
+        h[i]=(k+e2-1.0)/k*tt;
+    }
+}
+static VKERNEL void enu2ecefk(const double *sinp, const double *cosp,
+                              const double *sinl, const double *cosl,
+                              const double *e, const double *n,
+                              const double *u, double *x, double *y, double *z,
+                              int m)
+{
+    int i;
+    
+    for (i=0;i<m;i++) {
+        x[i]=-sinl[i]*e[i]-sinp[i]*cosl[i]*n[i]+cosp[i]*cosl[i]*u[i];
+        y[i]= cosl[i]*e[i]-sinp[i]*sinl[i]*n[i]+cosp[i]*sinl[i]*u[i];
+        z[i]=                       cosp[i]*n[i]+        sinp[i]*u[i];
+    }
+}
+static VKERNEL void ecef2enuk(const double *sinp, const double *cosp,
+                              const double *sinl, const double *cosl,
+                              const double *x, const double *y,
+                              const double *z, double *e, double *n,
+                              double *u, int m)
+{
+    int i;
+    
+    for (i=0;i<m;i++) {
+        e[i]=-sinl[i]*x[i]+cosl[i]*y[i];
+        n[i]=-sinp[i]*cosl[i]*x[i]-sinp[i]*sinl[i]*y[i]+cosp[i]*z[i];
+        u[i]= cosp[i]*cosl[i]*x[i]+cosp[i]*sinl[i]*y[i]+sinp[i]*z[i];
+    }
+}
+/* sin/cos of latitude/longitude for a block --------------------------------*/
+static void sincosblk(double *const *pos, int i, int m, double *sinp,
+                      double *cosp, double *sinl, double *cosl)
+{
+    int j;
+    
+    for (j=0;j<m;j++) {
+        sinp[j]=sin(pos[0][i+j]); cosp[j]=cos(pos[0][i+j]);
+        sinl[j]=sin(pos[1][i+j]); cosl[j]=cos(pos[1][i+j]);
+    }
+}
+/* transform geodetic to ecef positions ----------------------------------------
+* transform geodetic positions to ecef positions in columns
+* args   : double **pos     I   geodetic position columns {lat,lon,h} (rad,m)
+*          double **r       O   ecef position columns {x,y,z} (m)
+*          int    n         I   number of positions
+* return : none
+* notes  : WGS84, ellipsoidal height. r may be same columns as pos
+*-----------------------------------------------------------------------------*/
+extern void pos2ecefv(double *const *pos, double *const *r, int n)
+{
+    double sinp[NVBLK],cosp[NVBLK],sinl[NVBLK],cosl[NVBLK],h[NVBLK];
+    int i,m;
+    
+    for (i=0;i<n;i+=m) {
+        m=n-i<NVBLK?n-i:NVBLK;
+        sincosblk(pos,i,m,sinp,cosp,sinl,cosl);
+        memcpy(h,pos[2]+i,sizeof(double)*m);
+        pos2ecefk(sinp,cosp,sinl,cosl,h,r[0]+i,r[1]+i,r[2]+i,m);
+    }
+}
+/* transform ecef to geodetic positions ----------------------------------------
+* transform ecef positions to geodetic positions in columns
+* args   : double **r       I   ecef position columns {x,y,z} (m)
+*          double **pos     O   geodetic position columns {lat,lon,h} (rad,m)
+*          int    n         I   number of positions
+* return : none
+* notes  : WGS84, ellipsoidal height. pos may be same columns as r
+*          closed form by Vermeille (J.Geodesy 2002) without iteration. the
+*          error is under 1E-9 m for positions farther than 100 km from the
+*          geocenter, nearer ones are transformed by ecef2pos()
+*-----------------------------------------------------------------------------*/
+extern void ecef2posv(double *const *r, double *const *pos, int n)
+{
+    double x[NVBLK],y[NVBLK],z[NVBLK],r2[NVBLK],q[NVBLK],rt[NVBLK],a[NVBLK];
+    double d[NVBLK],rr[3],pp[3];
+    int i,j,m;
+    
+    for (i=0;i<n;i+=m) {
+        m=n-i<NVBLK?n-i:NVBLK;
+        memcpy(x,r[0]+i,sizeof(double)*m);
+        memcpy(y,r[1]+i,sizeof(double)*m);
+        memcpy(z,r[2]+i,sizeof(double)*m);
+        ecef2posk1(x,y,z,r2,q,rt,a,m);
+        for (j=0;j<m;j++) a[j]=cbrt(a[j]);
+        ecef2posk2(z,r2,q,rt,a,d,pos[2]+i,m);
+        for (j=0;j<m;j++) {
+            pos[0][i+j]=2.0*atan2(z[j],d[j]);
+            pos[1][i+j]=atan2(y[j],x[j]);
+        }
+        for (j=0;j<m;j++) { /* near geocenter */
+            if (r2[j]+z[j]*z[j]>=1E10) continue;
+            rr[0]=x[j]; rr[1]=y[j]; rr[2]=z[j];
+            ecef2pos(rr,pp);
+            pos[0][i+j]=pp[0]; pos[1][i+j]=pp[1]; pos[2][i+j]=pp[2];
+        }
+    }
+}
+/* transform local vectors to ecef ---------------------------------------------
+* transform local tangental coordinate vectors to ecef in columns
+* args   : double **pos     I   geodetic position columns {lat,lon} (rad)
+*          double **e       I   vector columns in local coordinate {e,n,u}
+*          double **r       O   vector columns in ecef coordinate {x,y,z}
+*          int    n         I   number of vectors
+* return : none
+* notes  : batch of enu2ecef(). r may be same columns as e
+*-----------------------------------------------------------------------------*/
+extern void enu2ecefv(double *const *pos, double *const *e, double *const *r,
+                      int n)
+{
+    double sinp[NVBLK],cosp[NVBLK],sinl[NVBLK],cosl[NVBLK];
+    double ee[NVBLK],nn[NVBLK],uu[NVBLK];
+    int i,m;
+    
+    for (i=0;i<n;i+=m) {
+        m=n-i<NVBLK?n-i:NVBLK;
+        sincosblk(pos,i,m,sinp,cosp,sinl,cosl);
+        memcpy(ee,e[0]+i,sizeof(double)*m);
+        memcpy(nn,e[1]+i,sizeof(double)*m);
+        memcpy(uu,e[2]+i,sizeof(double)*m);
+        enu2ecefk(sinp,cosp,sinl,cosl,ee,nn,uu,r[0]+i,r[1]+i,r[2]+i,m);
+    }
+}
+/* transform ecef vectors to local coordinate ----------------------------------
+* transform ecef vectors to local tangental coordinate in columns
+* args   : double **pos     I   geodetic position columns {lat,lon} (rad)
+*          double **r       I   vector columns in ecef coordinate {x,y,z}
+*          double **e       O   vector columns in local coordinate {e,n,u}
+*          int    n         I   number of vectors
+* return : none
+* notes  : batch of the matrix by xyz2enu() times vector. e may be same
+*          columns as r
+*-----------------------------------------------------------------------------*/
+extern void ecef2enuv(double *const *pos, double *const *r, double *const *e,
+                      int n)
+{
+    double sinp[NVBLK],cosp[NVBLK],sinl[NVBLK],cosl[NVBLK];
+    double x[NVBLK],y[NVBLK],z[NVBLK];
+    int i,m;
+    
+    for (i=0;i<n;i+=m) {
+        m=n-i<NVBLK?n-i:NVBLK;
+        sincosblk(pos,i,m,sinp,cosp,sinl,cosl);
+        memcpy(x,r[0]+i,sizeof(double)*m);
+        memcpy(y,r[1]+i,sizeof(double)*m);
+        memcpy(z,r[2]+i,sizeof(double)*m);
+        ecef2enuk(sinp,cosp,sinl,cosl,x,y,z,e[0]+i,e[1]+i,e[2]+i,m);
+    }
+}
+/* add to compensated sum ----------------------------------------------------*/
+static void addcomp(double *sum, double *comp, double x)
+{
+    double t=*sum+x;
+    
+    if (fabs(*sum)>=fabs(x)) *comp+=(*sum-t)+x; /* neumaier */
+    else *comp+=(x-t)+*sum;
+    *sum=t;
+}
+/* add positions to sum of positions -------------------------------------------
+* add ecef positions to compensated sum of positions
+* args   : possum_t *ps     IO  sum of positions
+*          double **r       I   ecef position columns {x,y,z} (m)
+*          int    n         I   number of positions
+* return : none
+* notes  : the sum is compensated by neumaier's algorithm, so the error of
+*          mean of millions of positions (~6e6 m) is at rounding of the mean
+*          instead of growing by the number of positions
+*-----------------------------------------------------------------------------*/
+extern void addpossum(possum_t *ps, double *const *r, int n)
+{
+    int i,j;
+    
+    for (j=0;j<3;j++) {
+        for (i=0;i<n;i++) addcomp(ps->sum+j,ps->comp+j,r[j][i]);
+    }
+    ps->n+=n;
+}
+/* merge sums of positions ---------------------------------------------------*/
+extern void mergepossum(possum_t *ps, const possum_t *src)
+{
+    int j;
+    
+    for (j=0;j<3;j++) {
+        addcomp(ps->sum+j,ps->comp+j,src->sum[j]);
+        addcomp(ps->sum+j,ps->comp+j,src->comp[j]);
+    }
+    ps->n+=src->n;
+}
+/* mean of sum of positions ----------------------------------------------------
+* args   : possum_t *ps     I   sum of positions
+*          double *rr       O   mean ecef position {x,y,z} (m)
+* return : status (1:ok,0:no position)
+*-----------------------------------------------------------------------------*/
+extern int meanpossum(const possum_t *ps, double *rr)
+{
+    int j;
+    
+    if (ps->n<=0) return 0;
+    for (j=0;j<3;j++) rr[j]=(ps->sum[j]+ps->comp[j])/ps->n;
+    return 1;
+}
+/* initialize memory arena -----------------------------------------------------
+* reserve address space of memory arena without memory
+* args   : arena_t *arena   O   memory arena
+*          size_t size      I   size of address space to reserve (bytes)
+*          int    huge      I   back by huge pages (0:off,1:on)
+* return : status (1:ok,0:error)
+* notes  : memory is committed by growarena() in segments of ARENASEG bytes
+*          and the contents never move, so the arena grows without copy.
+*          huge pages are advised to the kernel by madvise() (linux). on
+*          windows, huge pages are not used
+*-----------------------------------------------------------------------------*/
+extern int initarena(arena_t *arena, size_t size, int huge)
+{
+    void *p;
+    
+    arena->base=NULL; arena->size=arena->used=0; arena->huge=huge;
+    size=(size+ARENASEG-1)/ARENASEG*ARENASEG;
+#ifdef WIN32
+    if (!(p=VirtualAlloc(NULL,size,MEM_RESERVE,PAGE_NOACCESS))) return 0;
+#else
+    p=mmap(NULL,size,PROT_NONE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,-1,0);
+    if (p==MAP_FAILED) return 0;
+#ifdef MADV_HUGEPAGE
+    if (huge) madvise(p,size,MADV_HUGEPAGE);
+#endif
+#endif
+    arena->base=(char *)p;
+    arena->size=size;
+    return 1;
+}
+/* grow memory arena -----------------------------------------------------------
+* commit memory of arena up to size
+* args   : arena_t *arena   IO  memory arena
+*          size_t size      I   size of memory needed (bytes)
+* return : base address of arena (NULL: error or over reserved size)
+*-----------------------------------------------------------------------------*/
+extern void *growarena(arena_t *arena, size_t size)
+{
+    size_t n;
+    
+    if (size<=arena->used) return arena->base;
+    if (size>arena->size) return NULL;
+    
+    n=(size+ARENASEG-1)/ARENASEG*ARENASEG;
+    if (n>arena->size) n=arena->size;
+#ifdef WIN32
+    if (!VirtualAlloc(arena->base+arena->used,n-arena->used,MEM_COMMIT,
+                      PAGE_READWRITE)) return NULL;
+#else
+    if (mprotect(arena->base+arena->used,n-arena->used,PROT_READ|PROT_WRITE)) {
+        return NULL;
+    }
+#endif
+    arena->used=n;
+    return arena->base;
+}
+/* trim memory arena -----------------------------------------------------------
+* decommit memory of arena above size
+* args   : arena_t *arena   IO  memory arena
+*          size_t size      I   size of memory kept committed (bytes)
+* return : none
+* notes  : the pages above size are returned to the system and the address
+*          space is still reserved, so the arena grows again by growarena()
+*-----------------------------------------------------------------------------*/
+extern void trimarena(arena_t *arena, size_t size)
+{
+    size=(size+ARENASEG-1)/ARENASEG*ARENASEG;
+    if (size>=arena->used) return;
+#ifdef WIN32
+    VirtualFree(arena->base+size,arena->used-size,MEM_DECOMMIT);
+#else
+    madvise(arena->base+size,arena->used-size,MADV_DONTNEED);
+    mprotect(arena->base+size,arena->used-size,PROT_NONE);
+#endif
+    arena->used=size;
+}
+/* free memory arena ---------------------------------------------------------*/
+extern void freearena(arena_t *arena)
+{
+    if (!arena->base) return;
+#ifdef WIN32
+    VirtualFree(arena->base,0,MEM_RELEASE);
+#else
+    munmap(arena->base,arena->size);
+#endif
+    arena->base=NULL; arena->size=arena->used=0;
+}
+/* open memory mapped file -----------------------------------------------------
+* map regular file to memory for read
+* args   : char   *file     I   file path
+*          mapfile_t *map   O   memory mapped file
+* return : status (1:ok,0:error or not a regular file)
+* notes  : pipes, devices and empty files are not mapped. the caller should
+*          read them by stdio instead. the kernel is advised of sequential
+*          access to enable aggressive read-ahead
+*-----------------------------------------------------------------------------*/
+extern int openmap(const char *file, mapfile_t *map)
+{
+#ifdef WIN32
+    LARGE_INTEGER size;
+    
+    map->data=NULL; map->size=0;
+    map->file=CreateFileA(file,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,
+                          FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+    if (map->file==INVALID_HANDLE_VALUE) return 0;
+    
+    if (GetFileType(map->file)!=FILE_TYPE_DISK||!GetFileSizeEx(map->file,&size)||
+        size.QuadPart<=0||(ULONGLONG)size.QuadPart>(SIZE_T)-1) {
+        CloseHandle(map->file);
+        return 0;
+    }
+    if (!(map->mapping=CreateFileMappingA(map->file,NULL,PAGE_READONLY,0,0,NULL))) {
+        CloseHandle(map->file);
+        return 0;
+    }
+    if (!(map->data=(const char *)MapViewOfFile(map->mapping,FILE_MAP_READ,0,0,0))) {
+        CloseHandle(map->mapping);
+        CloseHandle(map->file);
+        return 0;
+    }
+    map->size=(size_t)size.QuadPart;
+    return 1;
+#else
+    struct stat st;
+    void *data;
+    int fd;
+    
+    map->data=NULL; map->size=0;
+    if ((fd=open(file,O_RDONLY))<0) return 0;
+    
+    if (fstat(fd,&st)||!S_ISREG(st.st_mode)||st.st_size<=0||
+        (unsigned long long)st.st_size>(size_t)-1) {
+        close(fd);
+        return 0;
+    }
+    data=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (data==MAP_FAILED) return 0;
+    
+    posix_madvise(data,(size_t)st.st_size,POSIX_MADV_SEQUENTIAL);
+    map->data=(const char *)data;
+    map->size=(size_t)st.st_size;
+    return 1;
+#endif
+}
+/* close memory mapped file ----------------------------------------------------
+* unmap file mapped by openmap()
+* args   : mapfile_t *map   IO  memory mapped file
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void closemap(mapfile_t *map)
+{
+    if (!map->data) return;
+#ifdef WIN32
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap((void *)map->data,map->size);
+#endif
+    map->data=NULL; map->size=0;
+}
+/* seek file by 64-bit offset --------------------------------------------------
+* args   : FILE   *fp       I   file pointer
+*          int64_t off      I   offset (bytes)
+*          int    origin    I   origin (SEEK_SET,SEEK_CUR,SEEK_END)
+* return : status (0:ok,-1:error) as fseek()
+*-----------------------------------------------------------------------------*/
+extern int fseekoff(FILE *fp, int64_t off, int origin)
+{
+#ifdef WIN32
+    return _fseeki64(fp,(__int64)off,origin)?-1:0;
+#else
+    return fseeko(fp,(off_t)off,origin)?-1:0;
+#endif
+}
+/* 64-bit offset of file (bytes) (-1:error) ----------------------------------*/
+extern int64_t ftelloff(FILE *fp)
+{
+#ifdef WIN32
+    return (int64_t)_ftelli64(fp);
+#else
+    return (int64_t)ftello(fp);
+#endif
+}
+/* truncate file to 64-bit size --------------------------------------------------
+* args   : FILE   *fp       I   file pointer (flushed)
+*          int64_t size     I   size of file (bytes)
+* return : status (0:ok,-1:error)
+*-----------------------------------------------------------------------------*/
+extern int ftruncoff(FILE *fp, int64_t size)
+{
+#ifdef WIN32
+    return _chsize_s(_fileno(fp),(__int64)size)?-1:0;
+#else
+    return ftruncate(fileno(fp),(off_t)size)?-1:0;
+#endif
+}
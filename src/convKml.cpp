@@ -21,131 +21,1606 @@
 *           2010/08/14  1.5  fix bug on readsolt() (2.4.0_p3)
 *           2017/06/10  1.6  support wild-card in input file
 *-----------------------------------------------------------------------------*/
-#include "../include/common.h"
+#include "../include/convKml.h"
 #include <cmath>
+#include <stdarg.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <ws2tcpip.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#endif
 
 /* constants -----------------------------------------------------------------*/
 
 #define SIZP     0.2            /* mark size of rover positions */
 #define SIZR     0.3            /* mark size of reference position */
 #define TINT     60.0           /* time label interval (sec) */
+#define MAXTHREAD 64            /* max number of worker threads */
+#define MINRECLEN 48            /* min length of solution record (bytes) */
+#define MAXOUTBUF (1<<20)       /* size of output buffer (bytes) */
+#define MAXOUTLINE 4096         /* max length of formatted output (bytes) */
+#define MAXTILEPT 1024          /* max number of points per tile */
+#define MAXTILELEVEL 20         /* max level of quadtree of tiles */
+#define MINLODPIX 128           /* min lod pixels of region of sub-tiles */
+#define MAXSIMPDEPTH 64         /* max depth of split by farthest vertex */
+#define MAXLIVEBUF 4096         /* size of read buffer of live input (bytes) */
+#define POSBLK   256            /* block of positions with offset for output */
+
+/* type definitions ----------------------------------------------------------*/
+
+typedef struct {        /* conversion job type */
+    char **infile;      /* input files */
+    char **outfile;     /* output files (NULL: <infile>.kml) */
+    int nfile;          /* number of files */
+    int next;           /* index of next file to convert */
+    const kmlopt_t *opt; /* conversion options */
+    int *stat;          /* status of each file */
+    double mem;         /* estimated memory of files in process and memory
+                           kept by converters of workers (bytes) */
+    int nrun;           /* number of files in process */
+    double maxmem;      /* memory budget (bytes) (0:no limit) */
+    lock_t lock;        /* lock flag */
+    cond_t cond;        /* signaled on end of file */
+} convjob_t;
+
+typedef struct {        /* output buffer type */
+    FILE *fp;           /* output file */
+    char *buff;         /* buffer */
+    int n;              /* number of bytes in buffer */
+    int own;            /* buffer allocated by openbuf() (0:no,1:yes) */
+    kmz_t *kmz;         /* kmz writer (NULL: plain kml) */
+} outbuf_t;
+
+typedef struct {        /* tiled output type */
+    const solbuf_t *solbuf; /* solution buffer */
+    char base[1024];    /* base path of tile files */
+    int pcolor;         /* point color */
+    int outalt;         /* output altitude */
+    timecur_t *tc;      /* time conversion cursor (NULL: no time) */
+    const double *dr;   /* offset in ecef (m) (NULL: no offset) */
+    const double *ll[2]; /* lat/lon of points with offset (rad) */
+    int maxlevel;       /* max level of quadtree */
+    int kmz;            /* root kml in kmz archive (0:no,1:yes) */
+    int *work;          /* work buffer of point indexes */
+    int ntile;          /* number of tiles */
+    int stat;           /* status (1:ok,0:error) */
+} kmltile_t;
+
+typedef struct {        /* block of output positions type */
+    const solbuf_t *solbuf; /* solution buffer */
+    const double *dr;   /* offset in ecef (m) (NULL: no offset) */
+    int i0,n;           /* index of first and number of positions in block */
+    double pos[3][POSBLK]; /* positions with offset {lat,lon,h} (rad,m) */
+} posblk_t;
+
+typedef struct {        /* streaming conversion type */
+    const kmlopt_t *opt; /* conversion options */
+    outbuf_t ob;        /* output buffer */
+    outbuf_t obt;       /* output buffer of temporary file */
+    outbuf_t *obp;      /* output of point folder (&obt or &ob) */
+    timecur_t tc;       /* time conversion cursor */
+    possum_t ps;        /* sum of positions for mean position */
+    double dr[3];       /* offset in ecef (m) */
+    gtime_t time;       /* time of last solution */
+    double pos[3];      /* last position output {lat,lon,h} (rad,m) */
+    int n;              /* number of solutions */
+    int nback;          /* number of solutions backward in time */
+    int sum;            /* sum positions by output (0:no,1:yes) */
+} kmlstr_t;
+
+typedef struct {        /* append checkpoint type */
+    int64_t off;        /* offset of input file read (bytes) */
+    uint64_t hash;      /* hash of input file before offset (srchash()) */
+    int line;           /* number of lines of input file before offset */
+    int64_t size;       /* size of input file (bytes) (set by loadckp()) */
+    int64_t trail;      /* offset of kml trailer in output file (bytes) */
+    int n;              /* number of solutions output */
+    int nback;          /* number of solutions backward in time */
+    double sum[3];      /* sum of positions {x,y,z} (ecef) (m) */
+    gtime_t time;       /* time of last solution */
+    double pos[3];      /* last position output {lat,lon,h} (rad,m) */
+} kmlckp_t;
+
+typedef struct {        /* live input stream type */
+    int fd;             /* file descriptor (-1:none) */
+#ifdef WIN32
+    SOCKET sock;        /* socket (INVALID_SOCKET:none) */
+#endif
+} livesrc_t;
+
+typedef struct {        /* live conversion type */
+    kmlopt_t opt;       /* conversion options */
+    const char *file;   /* output kml file */
+    solbuf_t solbuf;    /* cyclic buffer of live solutions */
+    int nsol;           /* number of solutions received */
+    int stop;           /* stop request of publisher */
+    int intv;           /* interval of snapshots (ms) */
+    int stat;           /* status of snapshots (1:ok,0:error) */
+    lock_t lock;        /* lock flag */
+} kmllive_t;
+
+const kmlopt_t kmlopt_default={ /* defaults kml conversion options */
+    {0},{0},0.0,0,              /* ts,te,tint,qflg */
+    {0.0,0.0,0.0},              /* offset */
+    4,5,0,1,                    /* tcolor,pcolor,outalt,outtime */
+    1,0.0,                      /* nthread,maxmem */
+    {1,1,0,0,NULL,NULL,0,NULL}, /* ropt (mmap,nthread,cache,index,arena,stat,mean, */
+                                /* rdbuf) */
+    0,0.0,0,0,0,                /* stream,tsimp,tile,kmz,append */
+    0,0                         /* arena,stats */
+};
 
 static const char *head1="<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
 static const char *head2="<kml xmlns=\"http://earth.google.com/kml/2.1\">";
 static const char *mark="http://maps.google.com/mapfiles/kml/pal2/icon18.png";
+static const char *color[]={
+    "ffffffff","ff008800","ff00aaff","ff0000ff","ff00ffff","ffff00ff"
+};
+static const int qcolor[]={0,1,2,5,4,3,0};
 
+/* open output buffer (buff: MAXOUTBUF bytes, NULL: allocated) --------------*/
+static int openbuf(outbuf_t *ob, FILE *fp, kmz_t *kmz, char *buff)
+{
+    ob->fp=fp;
+    ob->n=0;
+    ob->kmz=kmz;
+    ob->own=!buff;
+    if (!(ob->buff=buff?buff:(char *)malloc(MAXOUTBUF))) {
+        fprintf(stderr,"output buffer allocation error\n");
+        return 0;
+    }
+    return 1;
+}
+/* flush output buffer -------------------------------------------------------*/
+static void flushbuf(outbuf_t *ob)
+{
+    if (ob->n>0) {
+        if (ob->kmz) writekmz(ob->kmz,ob->buff,ob->n);
+        else fwrite(ob->buff,1,ob->n,ob->fp);
+    }
+    ob->n=0;
+}
+/* close output buffer (the file is not closed) ------------------------------*/
+static void closebuf(outbuf_t *ob)
+{
+    flushbuf(ob);
+    if (ob->own) free(ob->buff);
+    ob->buff=NULL;
+}
+/* reserve space in output buffer --------------------------------------------*/
+static char *reservebuf(outbuf_t *ob, int n)
+{
+    if (ob->n+n>MAXOUTBUF) flushbuf(ob);
+    return ob->buff+ob->n;
+}
+/* output bytes to buffer ----------------------------------------------------*/
+static void outbytes(outbuf_t *ob, const char *buff, int n)
+{
+    if (n>MAXOUTLINE) {
+        flushbuf(ob);
+        if (ob->kmz) writekmz(ob->kmz,buff,n);
+        else fwrite(buff,1,n,ob->fp);
+        return;
+    }
+    memcpy(reservebuf(ob,n),buff,n);
+    ob->n+=n;
+}
+/* output string to buffer ---------------------------------------------------*/
+static void outstr(outbuf_t *ob, const char *str)
+{
+    outbytes(ob,str,(int)strlen(str));
+}
+/* output formatted string to buffer -----------------------------------------*/
+static void outprintf(outbuf_t *ob, const char *format, ...)
+{
+    va_list ap;
+    char *p=reservebuf(ob,MAXOUTLINE);
+    int n;
+    
+    va_start(ap,format);
+    n=vsnprintf(p,MAXOUTLINE,format,ap);
+    va_end(ap);
+    if (n>=MAXOUTLINE) n=MAXOUTLINE-1; /* truncated */
+    if (n>0) ob->n+=n;
+}
+/* copy string without terminating '\0' -------------------------------------*/
+static char *putstr(char *p, const char *str)
+{
+    while (*str) *p++=*str++;
+    return p;
+}
+/* format integer --------------------------------------------------------------
+* format non-negative integer as sprintf("%0*d",width,val)
+*-----------------------------------------------------------------------------*/
+static char *fmtint(char *p, uint64_t val, int width)
+{
+    char digit[24];
+    int n=0;
+    
+    do {
+        digit[n++]=(char)('0'+val%10);
+        val/=10;
+    } while (val>0);
+    while (width-->n) *p++='0';
+    while (n>0) *p++=digit[--n];
+    return p;
+}
+/* format fixed-point number ---------------------------------------------------
+* format double as sprintf("%*.*f",width,prec,val) or sprintf("%0*.*f",...)
+* args   : char   *p        O   output buffer
+*          double val       I   value
+*          int    width     I   minimum field width
+*          int    prec      I   digits under decimal point (0-9)
+*          int    zero      I   pad with zeros instead of spaces (0:no,1:yes)
+* return : end of output (not terminated by '\0')
+* notes  : the value scaled by 10^prec is rounded as integer. the product of
+*          the scaling is not exact, so a value near to a tie of rounding
+*          (within 1e-4 of the last digit) or too large (>=2^38 scaled) is
+*          formatted by sprintf() to output identical digits to printf()
+*-----------------------------------------------------------------------------*/
+static char *fmtfix(char *p, double val, int width, int prec, int zero)
+{
+    static const double pow10[]={1E0,1E1,1E2,1E3,1E4,1E5,1E6,1E7,1E8,1E9};
+    static const uint64_t ipow10[]={
+        1,10,100,1000,10000,100000,1000000,10000000,100000000,1000000000
+    };
+    char buff[48],*q=buff;
+    double s,f;
+    uint64_t ival;
+    int n;
+    
+    s=fabs(val)*pow10[prec];
+    if (!(s<274877906944.0)) { /* 2^38 including nan and inf */
+        return p+sprintf(p,zero?"%0*.*f":"%*.*f",width,prec,val);
+    }
+    f=s-floor(s);
+    if (fabs(f-0.5)<1E-4) {
+        return p+sprintf(p,zero?"%0*.*f":"%*.*f",width,prec,val);
+    }
+    ival=(uint64_t)s+(f>0.5?1:0);
+    
+    if (copysign(1.0,val)<0.0) *q++='-'; /* including -0.0 */
+    q=fmtint(q,ival/ipow10[prec],1);
+    if (prec>0) {
+        *q++='.';
+        q=fmtint(q,ival%ipow10[prec],prec);
+    }
+    n=(int)(q-buff);
+    if (n<width) {
+        if (zero) {
+            if (buff[0]=='-') {*p++='-'; width--; n--; memmove(buff,buff+1,n);}
+            while (width-->n) *p++='0';
+        }
+        else {
+            while (width-->n) *p++=' ';
+        }
+    }
+    memcpy(p,buff,n);
+    return p+n;
+}
+/* output kml header ---------------------------------------------------------*/
+static void outhead(outbuf_t *ob)
+{
+    int i;
+    
+    outprintf(ob,"%s\n%s\n",head1,head2);
+    outprintf(ob,"<Document>\n");
+    for (i=0;i<6;i++) {
+        outprintf(ob,"<Style id=\"P%d\">\n",i);
+        outprintf(ob,"  <IconStyle>\n");
+        outprintf(ob,"    <color>%s</color>\n",color[i]);
+        outprintf(ob,"    <scale>%.1f</scale>\n",i==0?SIZR:SIZP);
+        outprintf(ob,"    <Icon><href>%s</href></Icon>\n",mark);
+        outprintf(ob,"  </IconStyle>\n");
+        outprintf(ob,"</Style>\n");
+    }
+}
+/* output track header -------------------------------------------------------*/
+static void outtrackhead(outbuf_t *ob, const char *color, int outalt,
+                         const char *desc)
+{
+    outprintf(ob,"<Placemark>\n");
+    outprintf(ob,"<name>Rover Track</name>\n");
+    if (*desc) outprintf(ob,"<description>%s</description>\n",desc);
+    outprintf(ob,"<Style>\n");
+    outprintf(ob,"<LineStyle>\n");
+    outprintf(ob,"<color>%s</color>\n",color);
+    outprintf(ob,"</LineStyle>\n");
+    outprintf(ob,"</Style>\n");
+    outprintf(ob,"<LineString>\n");
+    if (outalt) outprintf(ob,"<altitudeMode>absolute</altitudeMode>\n");
+    outprintf(ob,"<coordinates>\n");
+}
+/* format coordinates "lon,lat,hgt" ------------------------------------------*/
+static char *fmtcoord(char *p, const double *pos, double hgt)
+{
+    p=fmtfix(p,pos[1]*R2D,13,9,0); *p++=',';
+    p=fmtfix(p,pos[0]*R2D,12,9,0); *p++=',';
+    return fmtfix(p,hgt,5,3,0);
+}
+/* output track position -----------------------------------------------------*/
+static void outtrackpos(outbuf_t *ob, const double *pos, int outalt)
+{
+    double hgt=pos[2];
+    char *p=reservebuf(ob,MAXOUTLINE),*q=p;
+    
+    if      (outalt==0) hgt=0.0;
+   // else if (outalt==2) hgt-=geoidh(pos);
+    q=fmtcoord(q,pos,hgt);
+    *q++='\n';
+    ob->n+=(int)(q-p);
+}
+/* output track tail ---------------------------------------------------------*/
+static void outtracktail(outbuf_t *ob)
+{
+    outprintf(ob,"</coordinates>\n");
+    outprintf(ob,"</LineString>\n");
+    outprintf(ob,"</Placemark>\n");
+}
+/* add offset to geodetic position through ecef -----------------------------*/
+static void addoffpos(double *pos, const double *dr)
+{
+    double rr[3],*r[3],*p[3];
+    int i;
+    
+    for (i=0;i<3;i++) {
+        r[i]=rr+i; p[i]=pos+i;
+    }
+    pos2ecefv(p,r,1);
+    for (i=0;i<3;i++) rr[i]+=dr[i];
+    ecef2posv(r,p,1);
+}
+/* geodetic position of solution ---------------------------------------------
+* geodetic position of solution with offset in ecef (dr: NULL no offset)
+*-----------------------------------------------------------------------------*/
+static void solpos(const solbuf_t *solbuf, int i, const double *dr,
+                   double *pos)
+{
+    pos[0]=solbuf->pos[0][i];
+    pos[1]=solbuf->pos[1][i];
+    pos[2]=solbuf->pos[2][i];
+    if (dr) addoffpos(pos,dr);
+}
+/* initialize block of output positions ------------------------------------*/
+static void initposblk(posblk_t *pb, const solbuf_t *solbuf, const double *dr)
+{
+    pb->solbuf=solbuf;
+    pb->dr=dr;
+    pb->i0=pb->n=0;
+}
+/* geodetic position of solution by block ------------------------------------
+* geodetic position of solution with offset for sequential output. the offset
+* is added to the block of POSBLK positions from i by transformation through
+* ecef in batch
+*-----------------------------------------------------------------------------*/
+static void blkpos(posblk_t *pb, int i, double *pos)
+{
+    const solbuf_t *solbuf=pb->solbuf;
+    double *r[3],*p[3];
+    int j,k,m;
+    
+    if (!pb->dr) {
+        solpos(solbuf,i,NULL,pos);
+        return;
+    }
+    if (i<pb->i0||i>=pb->i0+pb->n) {
+        m=solbuf->n-i<POSBLK?solbuf->n-i:POSBLK;
+        for (j=0;j<3;j++) {
+            p[j]=solbuf->pos[j]+i;
+            r[j]=pb->pos[j];
+        }
+        pos2ecefv(p,r,m);
+        for (j=0;j<3;j++) {
+            for (k=0;k<m;k++) r[j][k]+=pb->dr[j];
+        }
+        ecef2posv(r,r,m);
+        pb->i0=i;
+        pb->n=m;
+    }
+    for (j=0;j<3;j++) pos[j]=pb->pos[j][i-pb->i0];
+}
+/* simplify track --------------------------------------------------------------
+* simplify track by Douglas-Peucker algorithm in local coordinate
+* args   : solbuf_t *solbuf I   solution buffer
+*          double tol       I   tolerance of distance (m)
+*          int    hor       I   distance (0:3d,1:horizontal)
+*          uint8_t *keep    O   vertices kept (1:keep,0:drop)
+* return : number of kept vertices (-1:memory allocation error)
+* notes  : positions are transformed to enu coordinate at the first vertex.
+*          the segments are split by explicit stack instead of recursion.
+*          segments deeper than MAXSIMPDEPTH splits are split at the middle
+*          vertex instead of the farthest one, so the cost is O(n log n) for
+*          usual tracks and O(n*(MAXSIMPDEPTH+log n)) in worst case (e.g. a
+*          zigzag of decreasing amplitude, where each split by the farthest
+*          vertex cuts off one vertex). the vertices dropped are within the
+*          tolerance in any case
+*-----------------------------------------------------------------------------*/
+static int simptrack(const solbuf_t *solbuf, double tol, int hor,
+                     uint8_t *keep)
+{
+    double *e[3],r0[3],E[9],d[3],dd,dmax,tt,t2,a[3];
+    int i,j,k,m,n=solbuf->n,nk=2,ns=0,dep,*stk;
+    
+    memset(keep,1,n);
+    if (n<=2) return n;
+    
+    e[0]=(double *)malloc(sizeof(double)*n*3);
+    stk=(int *)malloc(sizeof(int)*n*3);
+    if (!e[0]||!stk) {
+        free(e[0]); free(stk);
+        return -1;
+    }
+    e[1]=e[0]+n; e[2]=e[1]+n;
+    
+    /* local coordinate */
+    pos2ecefv(solbuf->pos,e,n);
+    for (m=0;m<3;m++) {
+        r0[m]=e[m][0];
+        a[m]=solbuf->pos[m][0];
+    }
+    xyz2enu(a,E);
+    for (i=0;i<n;i++) {
+        for (m=0;m<3;m++) d[m]=e[m][i]-r0[m];
+        for (m=0;m<3;m++) e[m][i]=E[m]*d[0]+E[m+3]*d[1]+E[m+6]*d[2];
+        if (hor) e[2][i]=0.0;
+    }
+    memset(keep,0,n);
+    keep[0]=keep[n-1]=1;
+    stk[ns++]=0; stk[ns++]=n-1; stk[ns++]=0;
+    
+    while (ns>0) {
+        dep=stk[--ns]; j=stk[--ns]; i=stk[--ns];
+        for (m=0;m<3;m++) a[m]=e[m][j]-e[m][i];
+        t2=a[0]*a[0]+a[1]*a[1]+a[2]*a[2];
+        
+        /* farthest vertex from segment i-j */
+        for (k=i+1,dmax=-1.0,m=i;k<j;k++) {
+            d[0]=e[0][k]-e[0][i]; d[1]=e[1][k]-e[1][i]; d[2]=e[2][k]-e[2][i];
+            tt=t2>0.0?(d[0]*a[0]+d[1]*a[1]+d[2]*a[2])/t2:0.0;
+            if      (tt<0.0) tt=0.0;
+            else if (tt>1.0) tt=1.0;
+            d[0]-=tt*a[0]; d[1]-=tt*a[1]; d[2]-=tt*a[2];
+            dd=d[0]*d[0]+d[1]*d[1]+d[2]*d[2];
+            if (dd>dmax) {dmax=dd; m=k;}
+            if (dep>=MAXSIMPDEPTH&&dmax>tol*tol) break;
+        }
+        if (dmax<=tol*tol) continue;
+        if (dep>=MAXSIMPDEPTH) m=(i+j)/2; /* split at middle */
+        keep[m]=1; nk++;
+        if (m-i>1) {stk[ns++]=i; stk[ns++]=m; stk[ns++]=dep+1;}
+        if (j-m>1) {stk[ns++]=m; stk[ns++]=j; stk[ns++]=dep+1;}
+    }
+    free(e[0]); free(stk);
+    return nk;
+}
 /* output track --------------------------------------------------------------*/
-static void outtrack(FILE *f, const solbuf_t *solbuf, const char *color,
-                     int outalt, int outtime)
+static void outtrack(outbuf_t *ob, const solbuf_t *solbuf, const char *color,
+                     int outalt, int outtime, double tsimp, const double *dr)
 {
+    posblk_t pb;
+    uint8_t *keep=NULL;
     double pos[3];
-    int i;
+    char desc[256]="";
+    int i,nk;
     
-    fprintf(f,"<Placemark>\n");
-    fprintf(f,"<name>Rover Track</name>\n");
-    fprintf(f,"<Style>\n");
-    fprintf(f,"<LineStyle>\n");
-    fprintf(f,"<color>%s</color>\n",color);
-    fprintf(f,"</LineStyle>\n");
-    fprintf(f,"</Style>\n");
-    fprintf(f,"<LineString>\n");
-    if (outalt) fprintf(f,"<altitudeMode>absolute</altitudeMode>\n");
-    fprintf(f,"<coordinates>\n");
+    /* track simplification */
+    if (tsimp>0.0&&(keep=(uint8_t *)malloc(solbuf->n>0?solbuf->n:1))) {
+        if ((nk=simptrack(solbuf,tsimp,!outalt,keep))<0) {
+            free(keep);
+            keep=NULL;
+        }
+        else {
+            sprintf(desc,"simplified (tolerance %.3f m): %d vertices kept, %d "
+                    "dropped",tsimp,nk,solbuf->n-nk);
+        }
+    }
+    if (tsimp>0.0&&!keep) {
+        fprintf(stderr,"track simplification memory allocation error\n");
+    }
+    outtrackhead(ob,color,outalt,desc);
+    initposblk(&pb,solbuf,dr);
     for (i=0;i<solbuf->n;i++) {
-        ecef2pos(solbuf->data[i].rr,pos);
-        if      (outalt==0) pos[2]=0.0;
-       // else if (outalt==2) pos[2]-=geoidh(pos);
-        fprintf(f,"%13.9f,%12.9f,%5.3f\n",pos[1]*R2D,pos[0]*R2D,pos[2]);
+        if (keep&&!keep[i]) continue;
+        blkpos(&pb,i,pos);
+        outtrackpos(ob,pos,outalt);
     }
-    fprintf(f,"</coordinates>\n");
-    fprintf(f,"</LineString>\n");
-    fprintf(f,"</Placemark>\n");
+    outtracktail(ob);
+    free(keep);
+}
+/* time system of output time ----------------------------------------------*/
+static int timesys(int outtime)
+{
+    return outtime==2?TIMES_UTC:(outtime==3?TIMES_JST:TIMES_GPST);
 }
 /* output point --------------------------------------------------------------*/
-static void outpoint(FILE *fp, gtime_t time, const double *pos,
-                     const char *label, int style, int outalt, int outtime)
+static void outpoint(outbuf_t *ob, gtime_t time, const double *pos,
+                     const char *label, int style, int outalt, timecur_t *tc)
 {
     double ep[6],alt=0.0;
-    char str[256]="";
-    
-    fprintf(fp,"<Placemark>\n");
-    if (*label) fprintf(fp,"<name>%s</name>\n",label);
-    fprintf(fp,"<styleUrl>#P%d</styleUrl>\n",style);
-    if (outtime) {
-        if      (outtime==2) time=gpst2utc(time);
-        else if (outtime==3) time=timeadd(gpst2utc(time),9*3600.0);
-        time2epoch(time,ep);
+    char *p,*q;
+    
+    if (*label) { /* reference position */
+        outstr(ob,"<Placemark>\n");
+        outprintf(ob,"<name>%s</name>\n",label);
+        q=p=reservebuf(ob,MAXOUTLINE);
+    }
+    else {
+        q=p=reservebuf(ob,MAXOUTLINE);
+        q=putstr(q,"<Placemark>\n");
+    }
+    q=putstr(q,"<styleUrl>#P");
+    q=fmtint(q,style,1);
+    q=putstr(q,"</styleUrl>\n");
+    if (tc) {
+        timecur2epoch(tc,time,ep);
         if (!*label&&fmod(ep[5]+0.005,TINT)<0.01) {
-            sprintf(str,"%02.0f:%02.0f",ep[3],ep[4]);
-            fprintf(fp,"<name>%s</name>\n",str);
+            q=putstr(q,"<name>");
+            q=fmtint(q,(uint64_t)ep[3],2); *q++=':';
+            q=fmtint(q,(uint64_t)ep[4],2);
+            q=putstr(q,"</name>\n");
         }
-        sprintf(str,"%04.0f-%02.0f-%02.0fT%02.0f:%02.0f:%05.2fZ",
-                ep[0],ep[1],ep[2],ep[3],ep[4],ep[5]);
-        fprintf(fp,"<TimeStamp><when>%s</when></TimeStamp>\n",str);
+        q=putstr(q,"<TimeStamp><when>");
+        q=fmtint(q,(uint64_t)ep[0],4); *q++='-';
+        q=fmtint(q,(uint64_t)ep[1],2); *q++='-';
+        q=fmtint(q,(uint64_t)ep[2],2); *q++='T';
+        q=fmtint(q,(uint64_t)ep[3],2); *q++=':';
+        q=fmtint(q,(uint64_t)ep[4],2); *q++=':';
+        q=fmtfix(q,ep[5],5,2,1);
+        q=putstr(q,"Z</when></TimeStamp>\n");
     }
-    fprintf(fp,"<Point>\n");
+    q=putstr(q,"<Point>\n");
     if (outalt) {
-        fprintf(fp,"<extrude>1</extrude>\n");
-        fprintf(fp,"<altitudeMode>absolute</altitudeMode>\n");
+        q=putstr(q,"<extrude>1</extrude>\n");
+        q=putstr(q,"<altitudeMode>absolute</altitudeMode>\n");
        // alt=pos[2]-(outalt==2?geoidh(pos):0.0);
     }
-    fprintf(fp,"<coordinates>%13.9f,%12.9f,%5.3f</coordinates>\n",pos[1]*R2D,
-            pos[0]*R2D,alt);
-    fprintf(fp,"</Point>\n");
-    fprintf(fp,"</Placemark>\n");
+    q=putstr(q,"<coordinates>");
+    q=fmtcoord(q,pos,alt);
+    q=putstr(q,"</coordinates>\n");
+    q=putstr(q,"</Point>\n");
+    q=putstr(q,"</Placemark>\n");
+    ob->n+=(int)(q-p);
 }
-/* save kml file -------------------------------------------------------------*/
-static int savekml(char *file, const solbuf_t *solbuf, int tcolor,
-                   int pcolor, int outalt, int outtime)
+/* output region of tile -----------------------------------------------------*/
+static void outregion(outbuf_t *ob, const double *box, int minlod)
 {
+    outprintf(ob,"<Region>\n");
+    outprintf(ob,"  <LatLonAltBox><north>%.9f</north><south>%.9f</south>"
+              "<east>%.9f</east><west>%.9f</west></LatLonAltBox>\n",box[0],
+              box[1],box[2],box[3]);
+    outprintf(ob,"  <Lod><minLodPixels>%d</minLodPixels>"
+              "<maxLodPixels>-1</maxLodPixels></Lod>\n",minlod);
+    outprintf(ob,"</Region>\n");
+}
+/* output network link to tile -------------------------------------------------
+* output network link to tile from root kml (root=1) or parent tile (root=0)
+* notes  : the tiles are written next to the kmz file, so the link from doc.kml
+*          in kmz is prefixed by "../" as the href is resolved from the root
+*          of the archive
+*-----------------------------------------------------------------------------*/
+static void outnetlink(outbuf_t *ob, const kmltile_t *kt, int root, int level,
+                       int x, int y, const double *box)
+{
+    const char *p=strrchr(kt->base,'/'),*q=strrchr(kt->base,'\\');
+    
+    if (!p||(q&&q>p)) p=q;
+    outprintf(ob,"<NetworkLink>\n");
+    outprintf(ob,"<name>%d_%d_%d</name>\n",level,x,y);
+    outregion(ob,box,level>0?MINLODPIX:0);
+    outprintf(ob,"<Link><href>%s%s_%d_%d_%d.kml</href>"
+              "<viewRefreshMode>onRegion</viewRefreshMode></Link>\n",
+              root&&kt->kmz?"../":"",p?p+1:kt->base,level,x,y);
+    outprintf(ob,"</NetworkLink>\n");
+}
+/* quadrant of point in tile (0:nw,1:ne,2:sw,3:se) -------------------------*/
+static int tilequad(const kmltile_t *kt, int i, double mlat, double mlon)
+{
+    return (kt->ll[0][i]*R2D>=mlat?0:2)+(kt->ll[1][i]*R2D>=mlon?1:0);
+}
+/* output tile -----------------------------------------------------------------
+* output points in tile of quadtree and tiles under it
+* args   : kmltile_t *kt    IO  tiled output
+*          int    level,x,y I   level and position of tile
+*          double *box      I   box of tile {north,south,east,west} (deg)
+*          int    *idx      IO  indexes of points in tile (time order)
+*          int    n         I   number of points in tile
+* return : none
+* notes  : up to MAXTILEPT points evenly sampled in time are written in the
+*          tile and the rest are distributed to the four sub-tiles. the tile
+*          is visible by region from level 0, so the points are decimated per
+*          level and only the tiles in view at a zoom are loaded
+*-----------------------------------------------------------------------------*/
+static void outtile(kmltile_t *kt, int level, int x, int y, const double *box,
+                    int *idx, int n)
+{
+    const solbuf_t *solbuf=kt->solbuf;
     FILE *fp;
+    outbuf_t ob;
+    double sbox[4][4],mlat=(box[0]+box[1])/2.0,mlon=(box[2]+box[3])/2.0;
     double pos[3];
-    int i,qcolor[]={0,1,2,5,4,3,0};
-    char *color[]={
-        "ffffffff","ff008800","ff00aaff","ff0000ff","ff00ffff","ffff00ff"
-    };
+    char file[1060];
+    int i,j,k,m,q,nsel,cnt[4]={0},off[4];
+    
+    /* select points of tile and sort rest by sub-tile */
+    nsel=n<=MAXTILEPT||level>=kt->maxlevel?n:MAXTILEPT;
+    for (i=j=k=m=0;i<n;i++) {
+        if (k<nsel&&i==(int)((int64_t)k*n/nsel)) {
+            idx[j++]=idx[i]; k++;
+        }
+        else {
+            kt->work[m++]=idx[i];
+            cnt[tilequad(kt,idx[i],mlat,mlon)]++;
+        }
+    }
+    for (q=0,off[0]=nsel;q<3;q++) off[q+1]=off[q]+cnt[q];
+    for (i=0;i<m;i++) {
+        q=tilequad(kt,kt->work[i],mlat,mlon);
+        idx[off[q]++]=kt->work[i];
+    }
+    for (q=0,off[0]=nsel;q<3;q++) off[q+1]=off[q]+cnt[q];
+    
+    for (q=0;q<4;q++) { /* sub-tile boxes (nw,ne,sw,se) */
+        sbox[q][0]=q<2?box[0]:mlat;
+        sbox[q][1]=q<2?mlat:box[1];
+        sbox[q][2]=q&1?box[2]:mlon;
+        sbox[q][3]=q&1?mlon:box[3];
+    }
+    sprintf(file,"%s_%d_%d_%d.kml",kt->base,level,x,y);
+    
     if (!(fp=fopen(file,"w"))) {
         fprintf(stderr,"file open error : %s\n",file);
+        kt->stat=0;
+        return;
+    }
+    if (!openbuf(&ob,fp,NULL,NULL)) {
+        fclose(fp);
+        kt->stat=0;
+        return;
+    }
+    outhead(&ob);
+    outregion(&ob,box,level>0?MINLODPIX:0);
+    for (i=0;i<nsel;i++) {
+        solpos(solbuf,idx[i],kt->dr,pos);
+        outpoint(&ob,tick2time(solbuf->t[idx[i]]),pos,"",kt->pcolor==5?
+                 qcolor[solbuf->stat[idx[i]]]:kt->pcolor-1,kt->outalt,kt->tc);
+    }
+    for (q=0;q<4;q++) {
+        if (cnt[q]>0) {
+            outnetlink(&ob,kt,0,level+1,x*2+(q&1),y*2+(q>>1),sbox[q]);
+        }
+    }
+    outprintf(&ob,"</Document>\n");
+    outprintf(&ob,"</kml>\n");
+    closebuf(&ob);
+    if (ferror(fp)) kt->stat=0;
+    fclose(fp);
+    kt->ntile++;
+    
+    for (q=0;q<4;q++) {
+        if (cnt[q]>0) {
+            outtile(kt,level+1,x*2+(q&1),y*2+(q>>1),sbox[q],idx+off[q],cnt[q]);
+        }
+    }
+}
+/* output tiled points ---------------------------------------------------------
+* output points as super-overlay of tiles <base>_<level>_<x>_<y>.kml linked
+* from the root kml by network link
+* args   : outbuf_t *ob     IO  output buffer of root kml
+*          char   *file     I   root kml file path
+*          solbuf_t *solbuf I   solution buffer
+*          int    pcolor    I   point color
+*          int    outalt    I   output altitude
+*          timecur_t *tc    IO  time conversion cursor (NULL: no time)
+*          int    maxlevel  I   max level of quadtree
+*          double *dr       I   offset of output positions in ecef (m)
+*                               (NULL: no offset)
+* return : status (1:ok,0:error)
+* notes  : with offset, lat/lon of points with offset are transformed once in
+*          blocks to split tiles
+*-----------------------------------------------------------------------------*/
+static int outtiles(outbuf_t *ob, const char *file, const solbuf_t *solbuf,
+                    int pcolor, int outalt, timecur_t *tc, int maxlevel,
+                    const double *dr)
+{
+    kmltile_t kt={0};
+    posblk_t *pb=NULL;
+    double box[4]={-90.0,90.0,-180.0,180.0},lat,lon,pos[3],*ll=NULL;
+    const char *p;
+    int i,*idx;
+    
+    if (solbuf->n<=0) return 1;
+    
+    if (!(idx=(int *)malloc(sizeof(int)*solbuf->n*2))||
+        (dr&&(!(ll=(double *)malloc(sizeof(double)*solbuf->n*2))||
+              !(pb=(posblk_t *)malloc(sizeof(posblk_t)))))) {
+        fprintf(stderr,"tile memory allocation error\n");
+        free(idx); free(ll); free(pb);
         return 0;
     }
-    fprintf(fp,"%s\n%s\n",head1,head2);
-    fprintf(fp,"<Document>\n");
-    for (i=0;i<6;i++) {
-        fprintf(fp,"<Style id=\"P%d\">\n",i);
-        fprintf(fp,"  <IconStyle>\n");
-        fprintf(fp,"    <color>%s</color>\n",color[i]);
-        fprintf(fp,"    <scale>%.1f</scale>\n",i==0?SIZR:SIZP);
-        fprintf(fp,"    <Icon><href>%s</href></Icon>\n",mark);
-        fprintf(fp,"  </IconStyle>\n");
-        fprintf(fp,"</Style>\n");
+    if (dr) { /* lat/lon with offset */
+        initposblk(pb,solbuf,dr);
+        for (i=0;i<solbuf->n;i++) {
+            blkpos(pb,i,pos);
+            ll[i]=pos[0];
+            ll[solbuf->n+i]=pos[1];
+        }
+        free(pb);
+        kt.ll[0]=ll;
+        kt.ll[1]=ll+solbuf->n;
+    }
+    else {
+        kt.ll[0]=solbuf->pos[0];
+        kt.ll[1]=solbuf->pos[1];
+    }
+    kt.solbuf=solbuf;
+    kt.pcolor=pcolor;
+    kt.outalt=outalt;
+    kt.tc=tc;
+    kt.dr=dr;
+    kt.maxlevel=maxlevel<MAXTILELEVEL?maxlevel:MAXTILELEVEL;
+    kt.kmz=ob->kmz!=NULL;
+    kt.work=idx+solbuf->n;
+    kt.stat=1;
+    if ((p=strrchr(file,'.'))&&(!strcmp(p,".kml")||!strcmp(p,".kmz"))) {
+        sprintf(kt.base,"%.*s",(int)(p-file),file);
+    }
+    else sprintf(kt.base,"%.1023s",file);
+    
+    /* box of all points */
+    for (i=0;i<solbuf->n;i++) {
+        idx[i]=i;
+        lat=kt.ll[0][i]*R2D;
+        lon=kt.ll[1][i]*R2D;
+        if (lat>box[0]) box[0]=lat;
+        if (lat<box[1]) box[1]=lat;
+        if (lon>box[2]) box[2]=lon;
+        if (lon<box[3]) box[3]=lon;
+    }
+    box[0]+=1E-7; box[1]-=1E-7; box[2]+=1E-7; box[3]-=1E-7;
+    
+    outnetlink(ob,&kt,1,0,0,0,box);
+    outtile(&kt,0,0,0,box,idx,solbuf->n);
+    free(idx);
+    free(ll);
+    return kt.stat;
+}
+/* open output kml file ------------------------------------------------------
+* open output kml file with output buffer
+* args   : char   *file     I   output file path
+*          int    kmz       I   output kmz (0:kml,1:kmz)
+*          outbuf_t *ob     O   output buffer
+*          kmz_t  *kz       O   kmz writer (used if kmz=1)
+*          char   *buff     I   buffer of output (MAXOUTBUF bytes)
+*                               (NULL: allocated until closekml())
+* return : output file (NULL: error)
+* notes  : kml is written as doc.kml in kmz archive, compressed by the threads
+*          of kmz writer while the next blocks are formatted in output buffer
+*-----------------------------------------------------------------------------*/
+static FILE *openkml(const char *file, int kmz, outbuf_t *ob, kmz_t *kz,
+                     char *buff)
+{
+    FILE *fp;
+    
+    if (!(fp=fopen(file,kmz?"wb":"w"))) {
+        fprintf(stderr,"file open error : %s\n",file);
+        return NULL;
+    }
+    if (kmz&&!openkmz(kz,fp,"doc.kml")) {
+        fclose(fp);
+        return NULL;
+    }
+    if (!openbuf(ob,fp,kmz?kz:NULL,buff)) {
+        if (kmz) closekmz(kz);
+        fclose(fp);
+        return NULL;
     }
-    if (tcolor>0) {
-        outtrack(fp,solbuf,color[tcolor-1],outalt,outtime);
+    return fp;
+}
+/* close output kml file -----------------------------------------------------*/
+static int closekml(FILE *fp, outbuf_t *ob)
+{
+    kmz_t *kz=ob->kmz;
+    int stat=1;
+    
+    closebuf(ob);
+    if (kz&&!closekmz(kz)) stat=0;
+    if (ferror(fp)) stat=0;
+    fclose(fp);
+    return stat;
+}
+/* save kml file ---------------------------------------------------------------
+* save solutions to kml file
+* args   : char   *file     I   output kml file
+*          solbuf_t *solbuf I   solution buffer
+*          kmlopt_t *opt    I   conversion options
+*          char   *buff     I   output buffer (NULL: allocated)
+*          double *dr       I   offset of positions in ecef (m) (NULL: no
+*                               offset), added to positions at output
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+static int savekml(const char *file, const solbuf_t *solbuf,
+                   const kmlopt_t *opt, char *buff, const double *dr)
+{
+    FILE *fp;
+    outbuf_t ob;
+    kmz_t kz;
+    timecur_t tc;
+    posblk_t pb;
+    double pos[3],rr[3];
+    int i,stat=1,pcolor=opt->pcolor,outalt=opt->outalt;
+    
+    if (!(fp=openkml(file,opt->kmz,&ob,&kz,buff))) return 0;
+    
+    if (opt->outtime) inittimecur(&tc,timesys(opt->outtime));
+    outhead(&ob);
+    if (opt->tcolor>0) {
+        outtrack(&ob,solbuf,color[opt->tcolor-1],outalt,opt->outtime,
+                 opt->tsimp,dr);
     }
     if (pcolor>0) {
-        fprintf(fp,"<Folder>\n");
-        fprintf(fp,"  <name>Rover Position</name>\n");
-        for (i=0;i<solbuf->n;i++) {
-            ecef2pos(solbuf->data[i].rr,pos);
-            outpoint(fp,solbuf->data[i].time,pos,"",
-                     pcolor==5?qcolor[solbuf->data[i].stat]:pcolor-1,outalt,outtime);
+        outprintf(&ob,"<Folder>\n");
+        outprintf(&ob,"  <name>Rover Position</name>\n");
+        if (opt->tile>0) {
+            stat=outtiles(&ob,file,solbuf,pcolor,outalt,
+                          opt->outtime?&tc:NULL,opt->tile,dr);
         }
-        fprintf(fp,"</Folder>\n");
+        else for (initposblk(&pb,solbuf,dr),i=0;i<solbuf->n;i++) {
+            blkpos(&pb,i,pos);
+            outpoint(&ob,tick2time(solbuf->t[i]),pos,"",
+                     pcolor==5?qcolor[solbuf->stat[i]]:pcolor-1,outalt,
+                     opt->outtime?&tc:NULL);
+        }
+        outprintf(&ob,"</Folder>\n");
     }
     if (norm(solbuf->rb,3)>0.0) {
-        ecef2pos(solbuf->rb,pos);
-        outpoint(fp,solbuf->data[0].time,pos,"Reference Position",0,outalt,0);
+        for (i=0;i<3;i++) rr[i]=solbuf->rb[i]+(dr?dr[i]:0.0);
+        ecef2pos(rr,pos);
+        outpoint(&ob,tick2time(solbuf->t[0]),pos,"Reference Position",0,outalt,
+                 NULL);
     }
-    fprintf(fp,"</Document>\n");
-    fprintf(fp,"</kml>\n");
+    outprintf(&ob,"</Document>\n");
+    outprintf(&ob,"</kml>\n");
+    if (!closekml(fp,&ob)) stat=0;
+    return stat;
+}
+/* add position of solution to sum -------------------------------------------*/
+static void addsolpos(kmlstr_t *str, const sol_t *sol)
+{
+    double rr[3],*r[3];
+    int i;
+    
+    pos2ecef(sol->rr,rr);
+    for (i=0;i<3;i++) r[i]=rr+i;
+    addpossum(&str->ps,r,1);
+}
+/* sum of positions for mean position ----------------------------------------*/
+static int sumpos(const sol_t *sol, void *arg)
+{
+    kmlstr_t *str=(kmlstr_t *)arg;
+    
+    addsolpos(str,sol);
+    str->n++;
+    return 1;
+}
+/* output solution to kml stream ---------------------------------------------*/
+static int outstrsol(const sol_t *sol, void *arg)
+{
+    kmlstr_t *str=(kmlstr_t *)arg;
+    const kmlopt_t *opt=str->opt;
+    double pos[3];
+    int i;
+    
+    if (str->sum) addsolpos(str,sol);
+    for (i=0;i<3;i++) pos[i]=sol->rr[i];
+    
+    /* add offset through ecef */
+    if (norm(str->dr,3)>0.0) addoffpos(pos,str->dr);
+    
+    if (opt->tcolor>0) outtrackpos(&str->ob,pos,opt->outalt);
+    for (i=0;i<3;i++) str->pos[i]=pos[i];
+    if (opt->pcolor>0) {
+        outpoint(str->obp,sol->time,pos,"",opt->pcolor==5?qcolor[sol->stat]:
+                 opt->pcolor-1,opt->outalt,opt->outtime?&str->tc:NULL);
+    }
+    if (str->n>0&&timediff(sol->time,str->time)<0.0) str->nback++;
+    str->time=sol->time;
+    str->n++;
+    return 1;
+}
+/* conversion options of checkpoint ----------------------------------------*/
+static void ckpopt(const kmlopt_t *opt, char *buff)
+{
+    sprintf(buff,"%d %d %d %d %d %.17g %.17g %.17g %.17g %lld %.17g %lld %.17g",
+            opt->tcolor,opt->pcolor,opt->outalt,opt->outtime,opt->qflg,
+            opt->tint,opt->offset[0],opt->offset[1],opt->offset[2],
+            (long long)opt->ts.time,opt->ts.sec,(long long)opt->te.time,
+            opt->te.sec);
+}
+/* hash of input file before offset ------------------------------------------*/
+static int ckphash(const char *infile, int64_t off, uint64_t *hash)
+{
+    FILE *fp;
+    int ret;
+    
+    if (!(fp=fopen(infile,"rb"))) return 0;
+    ret=srchash(fp,(uint64_t)off,hash);
     fclose(fp);
+    return ret;
+}
+/* load checkpoint -------------------------------------------------------------
+* load checkpoint <file>.ckp of last conversion in append mode
+* args   : char   *infile   I   input solution file
+*          char   *file     I   output kml file
+*          kmlopt_t *opt    I   conversion options
+*          kmlckp_t *ckp    O   checkpoint (cleared if not valid)
+* return : status (1:valid,0:not valid)
+* notes  : the checkpoint is valid if it has same options, the input file is
+*          not shorter than the offset read and has same hash of the bytes
+*          before the offset (not rewritten or rotated), and the output file
+*          ends by the trailer at the recorded offset
+*-----------------------------------------------------------------------------*/
+static int loadckp(const char *infile, const char *file, const kmlopt_t *opt,
+                   kmlckp_t *ckp)
+{
+    FILE *fp;
+    struct stat st;
+    char path[1036],buff[MAXOUTLINE],optstr[256];
+    unsigned long long hash;
+    uint64_t h;
+    long long off,trail,tt;
+    int ok=0;
+    
+    memset(ckp,0,sizeof(kmlckp_t));
+    sprintf(path,"%s.ckp",file);
+    ckpopt(opt,optstr);
+    
+    if (!(fp=fopen(path,"r"))) return 0;
+    if (fgets(buff,sizeof(buff),fp)&&!strncmp(buff,COMMENTH,1)&&
+        fgets(buff,sizeof(buff),fp)&&!strncmp(buff,"opt   : ",8)&&
+        !strncmp(buff+8,optstr,strlen(optstr))&&buff[8+strlen(optstr)]=='\n'&&
+        fscanf(fp,"off   : %lld\n",&off)==1&&
+        fscanf(fp,"hash  : %llx\n",&hash)==1&&
+        fscanf(fp,"line  : %d\n",&ckp->line)==1&&
+        fscanf(fp,"trail : %lld\n",&trail)==1&&
+        fscanf(fp,"n     : %d %d\n",&ckp->n,&ckp->nback)==2&&
+        fscanf(fp,"sum   : %lf %lf %lf\n",ckp->sum,ckp->sum+1,ckp->sum+2)==3&&
+        fscanf(fp,"time  : %lld %lf\n",&tt,&ckp->time.sec)==2&&
+        fscanf(fp,"pos   : %lf %lf %lf\n",ckp->pos,ckp->pos+1,ckp->pos+2)==3) {
+        ckp->off=off;
+        ckp->hash=hash;
+        ckp->trail=trail;
+        ckp->time.time=(time_t)tt;
+        ok=1;
+    }
+    fclose(fp);
+    
+    /* input file not truncated, rewritten or rotated */
+    if (ok&&(stat(infile,&st)||(long long)st.st_size<ckp->off||
+             !ckphash(infile,ckp->off,&h)||h!=ckp->hash)) ok=0;
+    else if (ok) ckp->size=(int64_t)st.st_size;
+    
+    /* output file ends by trailer at offset */
+    if (ok&&(fp=fopen(file,"r"))) {
+        ok=!fseekoff(fp,ckp->trail,SEEK_SET)&&
+           fgets(buff,sizeof(buff),fp)&&!strcmp(buff,"</Document>\n")&&
+           fgets(buff,sizeof(buff),fp)&&!strcmp(buff,"</kml>\n")&&
+           fgetc(fp)==EOF;
+        fclose(fp);
+    }
+    else ok=0;
+    
+    if (!ok) memset(ckp,0,sizeof(kmlckp_t));
+    return ok;
+}
+/* save checkpoint -----------------------------------------------------------*/
+static int saveckp(const char *file, const kmlopt_t *opt, const kmlckp_t *ckp)
+{
+    FILE *fp;
+    char path[1036],optstr[256];
+    int stat;
+    
+    sprintf(path,"%s.ckp",file);
+    ckpopt(opt,optstr);
+    
+    if (!(fp=fopen(path,"w"))) {
+        fprintf(stderr,"file open error : %s\n",path);
+        return 0;
+    }
+    fprintf(fp,"%s kml append checkpoint\n",COMMENTH);
+    fprintf(fp,"opt   : %s\n",optstr);
+    fprintf(fp,"off   : %lld\n",(long long)ckp->off);
+    fprintf(fp,"hash  : %016llx\n",(unsigned long long)ckp->hash);
+    fprintf(fp,"line  : %d\n",ckp->line);
+    fprintf(fp,"trail : %lld\n",(long long)ckp->trail);
+    fprintf(fp,"n     : %d %d\n",ckp->n,ckp->nback);
+    fprintf(fp,"sum   : %.17g %.17g %.17g\n",ckp->sum[0],ckp->sum[1],ckp->sum[2]);
+    fprintf(fp,"time  : %lld %.17g\n",(long long)ckp->time.time,ckp->time.sec);
+    fprintf(fp,"pos   : %.17g %.17g %.17g\n",ckp->pos[0],ckp->pos[1],ckp->pos[2]);
+    stat=!ferror(fp);
+    if (fclose(fp)||!stat) {
+        remove(path);
+        return 0;
+    }
     return 1;
 }
+/* restore output of last conversion -------------------------------------------
+* restore the trailer of output kml file at the offset of checkpoint and cut
+* the lines written after it, so the output and the checkpoint of the last
+* conversion are kept on error in append mode
+*-----------------------------------------------------------------------------*/
+static void restoreckp(const char *file, const kmlckp_t *ckp)
+{
+    static const char trail[]="</Document>\n</kml>\n";
+    FILE *fp;
+    
+    if (!(fp=fopen(file,"r+"))) {
+        fprintf(stderr,"file open error : %s\n",file);
+        return;
+    }
+    if (fseekoff(fp,ckp->trail,SEEK_SET)||fputs(trail,fp)==EOF||fflush(fp)||
+        ftruncoff(fp,ckp->trail+(int64_t)strlen(trail))) {
+        fprintf(stderr,"file restore error : %s\n",file);
+    }
+    fclose(fp);
+}
+/* convert solution file to kml file by streaming ------------------------------
+* convert solution file without solution buffer. the track and the points are
+* written in one pass in order of input file. the point folder is spilled to
+* a temporary file <file>.tmp and appended after the track, so the memory is
+* constant for any length of input. if offset is set, the mean position is
+* computed by a pre-pass over the file (input shall be a regular file).
+* the track is not simplified (tsimp) and the points are not tiled (tile)
+* since they need all solutions
+* in append mode (opt->append), the state after conversion (offset of input
+* read, offset of kml trailer, number and sum of positions, last time and
+* position) is saved to checkpoint <file>.ckp. next conversion reads only the
+* complete lines appended to input, overwrites the trailer by a new track
+* segment (from the last position) and point folder of them and the trailer.
+* the offset of new solutions is by the mean of all solutions, so solutions
+* already output keep the offset by the mean at their time. without offset,
+* the positions are summed by the output pass and no pre-pass is done. the
+* lines of input before the offset are counted in the checkpoint, so invalid
+* lines are reported by line number of whole file. without valid
+* checkpoint, the file is converted from the start. on error, the output and
+* the checkpoint of last conversion are kept. not for kmz output
+*-----------------------------------------------------------------------------*/
+static int convstream(const char *infile, const char *file, const kmlopt_t *opt)
+{
+    kmlstr_t str={0};
+    kmlckp_t ckp={0},nckp={0};
+    kmz_t kz;
+    rdopt_t ropt=opt->ropt,popt;
+    possum_t cps={{0}};
+    FILE *fp,*fpt=NULL;
+    double pos[3],rr[3],sum[3]={0};
+    char tmpfile[1036],buff[65536];
+    int64_t range[2]={0},*rng=NULL,trail=0;
+    size_t n;
+    int i,stat=0,append=opt->append&&!opt->kmz,cont=0,line=0,pline;
+    
+    str.opt=opt;
+    if (opt->outtime) inittimecur(&str.tc,timesys(opt->outtime));
+    
+    /* checkpoint of last conversion */
+    if (append) {
+        cont=loadckp(infile,file,opt,&ckp);
+        if (cont&&ckp.size==ckp.off) return 0; /* no line appended */
+        range[0]=ckp.off;
+        rng=range;
+        line=ckp.line;
+        ropt.mmap=1;
+    }
+    for (i=0;i<3;i++) cps.sum[i]=ckp.sum[i];
+    cps.n=ckp.n;
+    
+    /* mean position (and end of complete lines to read) by pre-pass */
+    if (norm(opt->offset,3)>0.0) {
+        popt=ropt;
+        popt.stat=NULL; /* counted by main pass */
+        pline=line;
+        if (readsolcbx((char *)infile,rng,rng?&pline:NULL,opt->ts,opt->te,
+                       opt->tint,opt->qflg,&popt,sumpos,&str)<=0) {
+            return cont?0:-3; /* no new solution in append mode */
+        }
+        /* sum of positions with checkpoint */
+        mergepossum(&str.ps,&cps);
+        for (i=0;i<3;i++) sum[i]=str.ps.sum[i]+str.ps.comp[i];
+        if (meanpossum(&str.ps,rr)) {
+            ecef2pos(rr,pos);
+            enu2ecef(pos,opt->offset,str.dr);
+        }
+        str.n=0;
+    }
+    else str.sum=append; /* sum of positions by output for checkpoint */
+    sprintf(tmpfile,"%s.tmp",file);
+    str.obp=&str.ob;
+    
+    if (opt->tcolor>0&&opt->pcolor>0) {
+        if (!(fpt=fopen(tmpfile,"w+"))) {
+            fprintf(stderr,"file open error : %s\n",tmpfile);
+            return -4;
+        }
+        if (!openbuf(&str.obt,fpt,NULL,NULL)) {
+            fclose(fpt);
+            remove(tmpfile);
+            return -4;
+        }
+        str.obp=&str.obt;
+    }
+    if (cont) { /* overwrite trailer of last conversion */
+        if ((fp=fopen(file,"r+"))&&(fseekoff(fp,ckp.trail,SEEK_SET)||
+                                   !openbuf(&str.ob,fp,NULL,NULL))) {
+            fclose(fp);
+            fp=NULL;
+        }
+    }
+    else fp=openkml(file,opt->kmz,&str.ob,&kz,NULL);
+    
+    if (!fp) {
+        if (fpt) {
+            closebuf(&str.obt);
+            fclose(fpt);
+            remove(tmpfile);
+        }
+        return -4;
+    }
+    str.n=ckp.n;
+    str.nback=ckp.nback;
+    str.time=ckp.time;
+    
+    if (!cont) outhead(&str.ob);
+    if (opt->tcolor>0) {
+        outtrackhead(&str.ob,color[opt->tcolor-1],opt->outalt,"");
+        if (cont) outtrackpos(&str.ob,ckp.pos,opt->outalt);
+    }
+    else if (opt->pcolor>0) {
+        outprintf(&str.ob,"<Folder>\n");
+        outprintf(&str.ob,"  <name>Rover Position</name>\n");
+    }
+    if (readsolcbx((char *)infile,rng,rng?&line:NULL,opt->ts,opt->te,opt->tint,
+                   opt->qflg,&ropt,outstrsol,&str)<0) {
+        fprintf(stderr,"file open error : %s\n",infile);
+        stat=-1;
+    }
+    else if (str.n<=ckp.n) stat=-3;
+    
+    if (str.sum) { /* sum of positions with checkpoint */
+        mergepossum(&str.ps,&cps);
+        for (i=0;i<3;i++) sum[i]=str.ps.sum[i]+str.ps.comp[i];
+    }
+    
+    if (opt->tcolor>0) {
+        outtracktail(&str.ob);
+        if (opt->pcolor>0) {
+            outprintf(&str.ob,"<Folder>\n");
+            outprintf(&str.ob,"  <name>Rover Position</name>\n");
+            closebuf(&str.obt);
+            rewind(fpt);
+            while ((n=fread(buff,1,sizeof(buff),fpt))>0) {
+                outbytes(&str.ob,buff,(int)n);
+            }
+            fclose(fpt);
+            remove(tmpfile);
+        }
+    }
+    if (opt->pcolor>0) outprintf(&str.ob,"</Folder>\n");
+    if (append) {
+        flushbuf(&str.ob);
+        trail=ftelloff(fp);
+    }
+    outprintf(&str.ob,"</Document>\n");
+    outprintf(&str.ob,"</kml>\n");
+    if (!closekml(fp,&str.ob)) stat=-4;
+    
+    if (append&&!stat) { /* new checkpoint (last one kept for restore) */
+        nckp.off=range[1];
+        nckp.line=line;
+        if (!ckphash(infile,nckp.off,&nckp.hash)) {
+            fprintf(stderr,"file read error : %s\n",infile);
+            stat=-1;
+        }
+        nckp.trail=trail;
+        nckp.n=str.n;
+        nckp.nback=str.nback;
+        for (i=0;i<3;i++) nckp.sum[i]=sum[i];
+        nckp.time=str.time;
+        for (i=0;i<3;i++) nckp.pos[i]=str.pos[i];
+        if (!stat&&!saveckp(file,opt,&nckp)) stat=-4;
+    }
+    if (stat) { /* keep output of last conversion in append mode */
+        if (cont) restoreckp(file,&ckp);
+        else remove(file);
+    }
+    else if (str.nback>0) {
+        fprintf(stderr,"%s: %d solution(s) not in time order\n",infile,str.nback);
+    }
+    return cont&&stat==-3?0:stat; /* no new solution in append mode */
+}
+/* output file path ---------------------------------------------------------*/
+static void outfilepath(const char *infile, const char *outfile, const char *ext,
+                        char *file)
+{
+    const char *p;
+    
+    if (outfile&&*outfile) {
+        strcpy(file,outfile);
+    }
+    else if ((p=strrchr(infile,'.'))) {
+        strncpy(file,infile,p-infile);
+        strcpy(file+(p-infile),ext);
+    }
+    else sprintf(file,"%s%s",infile,ext);
+}
+/* estimate memory to convert file ---------------------------------------------
+* memory resident while a file is converted: mapped input plus solution
+* buffer, assuming MINRECLEN bytes per record and doubling growth of buffer.
+* memory kept by converters of workers between files is added by convthread()
+*-----------------------------------------------------------------------------*/
+static double estmem(const char *file)
+{
+    struct stat st;
+    
+    if (stat(file,&st)) return 0.0;
+    return (double)st.st_size*(1.0+2.0*(sizeof(int64_t)+sizeof(double)*3+1)/
+                               MINRECLEN);
+}
+/* offset by mean position ---------------------------------------------------
+* offset {east,north,up} at mean position of solutions in ecef
+* args   : solbuf_t *solbuf IO  solution buffer
+*          double *offset   I   offset {east,north,up} (m)
+*          double *dr       O   offset in ecef (m)
+* return : offset in ecef (dr) (NULL: no offset)
+* notes  : the solutions are not changed. the offset is added to positions at
+*          output, see savekml(). the mean position is by the sum of positions
+*          while read if rdopt_t.mean is set, see solmean()
+*-----------------------------------------------------------------------------*/
+static const double *meanoffset(solbuf_t *solbuf, const double *offset,
+                                double *dr)
+{
+    double rr[3],pos[3];
+    
+    if (norm(offset,3)<=0.0||!solmean(solbuf,rr)) return NULL;
+    ecef2pos(rr,pos);
+    enu2ecef(pos,offset,dr);
+    return dr;
+}
+/* output json string -------------------------------------------------------*/
+static void outjsonstr(FILE *fp, const char *str)
+{
+    fputc('"',fp);
+    for (;*str;str++) {
+        if (*str=='"'||*str=='\\') fprintf(fp,"\\%c",*str);
+        else if ((unsigned char)*str<0x20) fprintf(fp,"\\u%04x",*str);
+        else fputc(*str,fp);
+    }
+    fputc('"',fp);
+}
+/* output statistics of conversion ---------------------------------------------
+* output statistics of conversion of a file as json document <file>.json
+* args   : char   *file     I   output kml file
+*          char   *infile   I   input solution file
+*          int    ret       I   status of conversion
+*          convstat_t *st   I   statistics of conversion
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+static int outstats(const char *file, const char *infile, int ret,
+                    const convstat_t *st)
+{
+    static const char *stage[]={"read","sort","write","total"};
+    FILE *fp;
+    char path[1024];
+    int i;
+    
+    sprintf(path,"%.1018s.json",file);
+    if (!(fp=fopen(path,"w"))) {
+        fprintf(stderr,"file open error : %s\n",path);
+        return 0;
+    }
+    fprintf(fp,"{\n  \"input\": ");
+    outjsonstr(fp,infile);
+    fprintf(fp,",\n  \"output\": ");
+    outjsonstr(fp,file);
+    fprintf(fp,",\n  \"status\": %d,\n",ret);
+    fprintf(fp,"  \"time\": {\n");
+    for (i=0;i<NSTAGE;i++) {
+        fprintf(fp,"    \"%s\": {\"wall\": %.6f, \"cpu\": %.6f}%s\n",stage[i],
+                st->wall[i],st->cpu[i],i<NSTAGE-1?",":"");
+    }
+    fprintf(fp,"  },\n");
+    fprintf(fp,"  \"bytes\": {\"in\": %.0f, \"out\": %.0f},\n",
+            (double)st->bytein,(double)st->byteout);
+    fprintf(fp,"  \"records\": {\"lines\": %.0f, \"read\": %.0f, \"kept\": %.0f, "
+            "\"rejected\": %.0f, \"invalid\": %.0f},\n",(double)st->nline,
+            (double)(st->nsol+st->nscr),(double)st->nsol,(double)st->nscr,
+            (double)st->nerr);
+    fprintf(fp,"  \"memory\": {\"columns\": %.0f, \"peak_rss\": %.0f, "
+            "\"grow\": %d}\n",st->memcol,st->maxrss,st->ngrow);
+    fprintf(fp,"}\n");
+    return !fclose(fp);
+}
+/* convert solution file to kml file by options -------------------------------
+* convert solution file to kml file by options with buffers of kml converter
+* notes  : the solution buffer of converter is cleared, not freed, after the
+*          conversion, so the columns are reused by the next file
+*-----------------------------------------------------------------------------*/
+static int convsol(const char *infile, const char *file, const kmlopt_t *opt,
+                   kmlconv_t *conv)
+{
+    convstat_t *st=opt->ropt.stat;
+    solbuf_t *solbuf=&conv->solbuf;
+    rdopt_t ropt=opt->ropt;
+    FILE *fp;
+    const double *off;
+    double t0[2],t1[2],dr[3];
+    int stat;
+    
+    if (!(fp=fopen(infile,"rb"))) {
+        fprintf(stderr,"file open error : %s\n",infile);
+        return -1;
+    }
+    fclose(fp);
+    
+    if (opt->stream||opt->append) return convstream(infile,file,opt);
+    
+    /* read solution file (with sum of positions if offset is set) */
+    ropt.mean=norm(opt->offset,3)>0.0;
+    if ((stat=readsoltx((char **)&infile,1,opt->ts,opt->te,opt->tint,
+                        opt->qflg,&ropt,solbuf))<=0) {
+        clearsolbuf(solbuf);
+        return stat<0?-1:-3;
+    }
+    /* offset in ecef by mean position (added to positions at output) */
+    off=meanoffset(solbuf,opt->offset,dr);
+    
+    /* save kml file */
+    if (st) proctime(t0);
+    stat=savekml(file,solbuf,opt,conv->buff,off);
+    if (st) {
+        proctime(t1);
+        st->wall[STG_WRITE]+=t1[0]-t0[0];
+        st->cpu [STG_WRITE]+=t1[1]-t0[1];
+    }
+    clearsolbuf(solbuf);
+    return stat?0:-4;
+}
+/* convert solution file to kml file -------------------------------------------
+* convert solution file to kml file by kml converter
+* notes  : if opt->stats is set, statistics of conversion are output to
+*          <file>.json by outstats(). all counters are kept per file, so the
+*          instrumentation costs only a few calls per file if disabled. in
+*          streaming conversion, reading and writing are not separated and
+*          only the total time is recorded
+*-----------------------------------------------------------------------------*/
+static int convfile(const char *infile, const char *outfile, kmlconv_t *conv)
+{
+    const kmlopt_t *opt=&conv->opt;
+    kmlopt_t sopt;
+    convstat_t st={{0}};
+    struct stat fs;
+    double t0[2],t1[2];
+    char file[1024];
+    int ret;
+    
+    outfilepath(infile,outfile,opt->kmz?".kmz":".kml",file);
+    
+    if (!opt->stats) return convsol(infile,file,opt,conv);
+    
+    sopt=*opt;
+    sopt.ropt.stat=&st;
+    proctime(t0);
+    ret=convsol(infile,file,&sopt,conv);
+    proctime(t1);
+    
+    st.wall[STG_TOTAL]=t1[0]-t0[0];
+    st.cpu [STG_TOTAL]=t1[1]-t0[1];
+    if (!stat(file,&fs)) st.byteout=(uint64_t)fs.st_size;
+    st.maxrss=peakmem();
+    outstats(file,infile,ret,&st);
+    return ret;
+}
+/* initialize kml converter ----------------------------------------------------
+* initialize kml converter with preallocated buffers
+* args   : kmlconv_t *conv  O   kml converter
+*          kmlopt_t *opt    I   conversion options (NULL: kmlopt_default)
+* return : status (1:ok,0:error)
+* notes  : the output buffer, the solution buffer and the buffers of solution
+*          reader (block buffer of file read and parse jobs) are owned by the
+*          converter and reused by every convkmlfile(). the solution buffer
+*          is cleared (n=0) instead of freed between files, so repeated
+*          conversions of small files have no setup allocation per file except
+*          the memory mapping of the input file. the columns over ARENAKEEP
+*          bytes are shrunk after a file, see clearsolbuf(). if opt->arena is
+*          set, the columns are in the arena of converter. if the allocation
+*          fails, the converter still converts files with the output buffer
+*          allocated per file. free the converter by freekmlconv()
+*-----------------------------------------------------------------------------*/
+extern int initkmlconv(kmlconv_t *conv, const kmlopt_t *opt)
+{
+    int stat=1;
+    
+    conv->opt=opt?*opt:kmlopt_default;
+    conv->opt.ropt.arena=NULL;
+    conv->aren=0;
+    initsolbuf(&conv->solbuf,0,0);
+    initrdbuf(&conv->rdbuf);
+    conv->opt.ropt.rdbuf=&conv->rdbuf;
+    
+    if (!(conv->buff=(char *)malloc(MAXOUTBUF))) {
+        fprintf(stderr,"output buffer allocation error\n");
+        stat=0;
+    }
+    if (conv->opt.arena&&!conv->opt.stream&&!conv->opt.append) {
+        if ((conv->aren=initsolarena(&conv->arena,conv->opt.arena==2))) {
+            conv->opt.ropt.arena=&conv->arena;
+        }
+        else stat=0;
+    }
+    return stat;
+}
+/* free kml converter --------------------------------------------------------*/
+extern void freekmlconv(kmlconv_t *conv)
+{
+    free(conv->buff);
+    conv->buff=NULL;
+    freesolbuf(&conv->solbuf);
+    freerdbuf(&conv->rdbuf);
+    conv->opt.ropt.rdbuf=NULL;
+    if (conv->aren) freesolarena(&conv->arena);
+    conv->aren=0;
+    conv->opt.ropt.arena=NULL;
+}
+/* convert solution file by kml converter --------------------------------------
+* convert solution file to google earth kml file by kml converter
+* args   : kmlconv_t *conv  IO  kml converter
+*          char   *infile   I   input solution file
+*          char   *outfile  I   output kml file (NULL or "":<infile>.kml,
+*                               <infile>.kmz if opt->kmz)
+* return : status (0:ok,-1:file read,-3:no data,-4:file write)
+* notes  : a converter is used by one thread at a time
+*-----------------------------------------------------------------------------*/
+extern int convkmlfile(kmlconv_t *conv, const char *infile,
+                       const char *outfile)
+{
+    return convfile(infile,outfile,conv);
+}
+/* memory kept by kml converter between files (bytes) -----------------------*/
+static double convmem(const kmlconv_t *conv)
+{
+    return (conv->aren?(double)solarenamem(&conv->arena):0.0)+
+           (double)solbufmem(&conv->solbuf)+(double)rdbufmem(&conv->rdbuf);
+}
+/* conversion worker thread --------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI convthread(void *arg)
+#else
+static void *convthread(void *arg)
+#endif
+{
+    convjob_t *job=(convjob_t *)arg;
+    kmlconv_t conv;
+    double mem,kept=0.0;
+    int i;
+    
+    /* buffers reused by files converted by the worker */
+    initkmlconv(&conv,job->opt);
+    
+    for (;;) {
+        lock(&job->lock);
+        if ((i=job->next)>=job->nfile) {
+            unlock(&job->lock);
+            break;
+        }
+        job->next++;
+        
+        /* wait for memory budget (a file always runs if no other in process).
+           the memory kept by converter of the worker is reused by the file */
+        mem=job->maxmem>0.0?estmem(job->infile[i]):0.0;
+        while (job->nrun>0&&job->mem-kept+mem>job->maxmem) {
+            waitcond(&job->cond,&job->lock);
+        }
+        job->mem+=mem-kept;
+        job->nrun++;
+        unlock(&job->lock);
+        
+        job->stat[i]=convfile(job->infile[i],job->outfile?job->outfile[i]:NULL,
+                              &conv);
+        kept=convmem(&conv);
+        lock(&job->lock);
+        job->mem+=kept-mem;
+        job->nrun--;
+        broadcastcond(&job->cond);
+        unlock(&job->lock);
+    }
+    freekmlconv(&conv);
+    
+    lock(&job->lock);
+    job->mem-=kept;
+    broadcastcond(&job->cond);
+    unlock(&job->lock);
+    return 0;
+}
+/* convert to google earth kml files by worker threads -------------------------
+* convert solution files to google earth kml files
+* args   : char   *infile[] I   input solution files
+*          char   *outfile[] I  output kml files (NULL or "":<infile>.kml,
+*                               <infile>.kmz if opt->kmz)
+*          int    nfile     I   number of files
+*          kmlopt_t *opt    I   conversion options (NULL: kmlopt_default)
+*          int    *stat     O   status of each file (NULL: no output)
+*                               (0:ok,-1:file read,-3:no data,-4:file write)
+* return : status (0:all ok, else status of first failed file)
+* notes  : each file is converted by a job with own solution buffer. opt->
+*          nthread jobs run in parallel, and a job waits while the estimated
+*          memory of files in process plus the memory kept by converters of
+*          workers exceeds opt->maxmem. a worker converts
+*          the files by an own converter, see initkmlconv()
+*-----------------------------------------------------------------------------*/
+extern int convkmlx(char *infile[], char *outfile[], int nfile,
+                    const kmlopt_t *opt, int *stat)
+{
+    convjob_t job={0};
+    thread_t thread[MAXTHREAD];
+    int i,n,ret=0,*st;
+    
+    if (nfile<=0) return -3;
+    if (!opt) opt=&kmlopt_default;
+    if (!(st=stat?stat:(int *)malloc(sizeof(int)*nfile))) return -4;
+    
+    job.infile=infile;
+    job.outfile=outfile;
+    job.nfile=nfile;
+    job.opt=opt;
+    job.stat=st;
+    job.maxmem=opt->maxmem*1E6;
+    initlock(&job.lock);
+    initcond(&job.cond);
+    
+    n=opt->nthread<1?1:(opt->nthread>MAXTHREAD?MAXTHREAD:opt->nthread);
+    if (n>nfile) n=nfile;
+    
+    if (n<=1) {
+        convthread(&job);
+    }
+    else {
+        for (i=0;i<n;i++) {
+#ifdef WIN32
+            if (!(thread[i]=CreateThread(NULL,0,convthread,&job,0,NULL))) break;
+#else
+            if (pthread_create(thread+i,NULL,convthread,&job)) break;
+#endif
+        }
+        if (i==0) convthread(&job); /* no thread created */
+        for (n=i,i=0;i<n;i++) {
+#ifdef WIN32
+            WaitForSingleObject(thread[i],INFINITE);
+            CloseHandle(thread[i]);
+#else
+            pthread_join(thread[i],NULL);
+#endif
+        }
+    }
+    freecond(&job.cond);
+    freelock(&job.lock);
+    
+    for (i=0;i<nfile;i++) {
+        if (st[i]) {ret=st[i]; break;}
+    }
+    if (!stat) free(st);
+    return ret;
+}
 /* convert to google earth kml file --------------------------------------------
 * convert solutions to google earth kml file
-* args   : char   *infile   I   input solutions file (wild-card (*) is expanded)
-*          char   *outfile  I   output google earth kml file ("":<infile>.kml)
+* args   : char   *infile[] I   input solutions files
+*          char   *outfile[] I  output google earth kml files
+*                               (NULL or "":<infile>.kml)
 *          gtime_t ts,te    I   start/end time (gpst)
+*          int    nfile     I   number of files
 *          int    tint      I   time interval (s) (0.0:all)
 *          int    qflg      I   quality flag (0:all)
 *          double *offset   I   add offset {east,north,up} (m)
@@ -162,67 +1637,293 @@ extern int convkml(char *infile[], char *outfile[], gtime_t ts,
                    gtime_t te, int nfile,double tint, int qflg, double *offset,
                    int tcolor, int pcolor, int outalt, int outtime)
 {
-    solbuf_t solbuf={0};
-    double rr[3]={0},pos[3],dr[3];
-    int i,j,m,stat,ret;
-    const char *p;
-   // char file[MAXEXFILE][1024] = {0};
-    char *file[MAXEXFILE] = {0};
-    char *files[MAXEXFILE] = { 0 };
+    kmlopt_t opt=kmlopt_default;
+    int i;
     
-    //trace(3,"convkml : infile=%s outfile=%s\n",infile,outfile);
+    opt.ts=ts; opt.te=te; opt.tint=tint; opt.qflg=qflg;
+    for (i=0;i<3;i++) opt.offset[i]=offset[i];
+    opt.tcolor=tcolor; opt.pcolor=pcolor; opt.outalt=outalt; opt.outtime=outtime;
     
-    /* expand wild-card of infile */
-    for (i=0;i<MAXEXFILE;i++) {
-        if (!(files[i]=(char *)malloc(1024))) {
-            for (i--;i>=0;i--) free(files[i]);
-            return -4;
+    return convkmlx(infile,outfile,nfile,&opt,NULL);
+}
+/* open live input stream ------------------------------------------------------
+* open input stream of live solutions
+* args   : char   *path     I   input path ("-":stdin,"tcp://host:port":tcp
+*                               client,others:file or fifo)
+*          livesrc_t *src   O   live input stream
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+static int openlive(const char *path, livesrc_t *src)
+{
+    struct addrinfo hints={0},*ai,*p;
+    char host[256],port[32];
+    const char *q;
+#ifdef WIN32
+    WSADATA data;
+    SOCKET sock=INVALID_SOCKET;
+    
+    src->sock=INVALID_SOCKET;
+#else
+    int sock=-1;
+#endif
+    src->fd=-1;
+    
+    if (!strcmp(path,"-")) {
+        src->fd=0;
+        return 1;
+    }
+    if (strncmp(path,"tcp://",6)) {
+#ifdef WIN32
+        src->fd=_open(path,_O_RDONLY|_O_BINARY);
+#else
+        src->fd=open(path,O_RDONLY);
+#endif
+        return src->fd>=0;
+    }
+    if (!(q=strrchr(path+6,':'))||q-path-6>=(int)sizeof(host)) return 0;
+    sprintf(host,"%.*s",(int)(q-path-6),path+6);
+    sprintf(port,"%.31s",q+1);
+    hints.ai_family=AF_UNSPEC;
+    hints.ai_socktype=SOCK_STREAM;
+#ifdef WIN32
+    if (WSAStartup(MAKEWORD(2,0),&data)) return 0;
+#endif
+    if (getaddrinfo(*host?host:"localhost",port,&hints,&ai)) return 0;
+    
+    for (p=ai;p;p=p->ai_next) {
+        sock=socket(p->ai_family,p->ai_socktype,p->ai_protocol);
+#ifdef WIN32
+        if (sock==INVALID_SOCKET) continue;
+        if (!connect(sock,p->ai_addr,(int)p->ai_addrlen)) break;
+        closesocket(sock);
+        sock=INVALID_SOCKET;
+#else
+        if (sock<0) continue;
+        if (!connect(sock,p->ai_addr,p->ai_addrlen)) break;
+        close(sock);
+        sock=-1;
+#endif
+    }
+    freeaddrinfo(ai);
+#ifdef WIN32
+    src->sock=sock;
+    return sock!=INVALID_SOCKET;
+#else
+    src->fd=sock;
+    return sock>=0;
+#endif
+}
+/* read live input stream (blocking) -----------------------------------------*/
+static int readlive(livesrc_t *src, uint8_t *buff, int n)
+{
+#ifdef WIN32
+    if (src->sock!=INVALID_SOCKET) return recv(src->sock,(char *)buff,n,0);
+    return _read(src->fd,buff,n);
+#else
+    return (int)read(src->fd,buff,n);
+#endif
+}
+/* close live input stream ---------------------------------------------------*/
+static void closelive(livesrc_t *src)
+{
+#ifdef WIN32
+    if (src->sock!=INVALID_SOCKET) {
+        closesocket(src->sock);
+        WSACleanup();
+    }
+    else if (src->fd>0) _close(src->fd);
+#else
+    if (src->fd>0) close(src->fd);
+#endif
+}
+/* output network link file of live kml --------------------------------------*/
+static int outlivelink(const char *file, double intv)
+{
+    FILE *fp;
+    outbuf_t ob;
+    const char *p=strrchr(file,'/'),*q=strrchr(file,'\\');
+    char path[1036];
+    int stat;
+    
+    if (!p||(q&&q>p)) p=q;
+    if ((q=strrchr(file,'.'))&&q>(p?p:file)) {
+        sprintf(path,"%.*s_link.kml",(int)(q-file),file);
+    }
+    else sprintf(path,"%s_link.kml",file);
+    
+    if (!(fp=openkml(path,0,&ob,NULL,NULL))) return 0;
+    outprintf(&ob,"%s\n%s\n",head1,head2);
+    outprintf(&ob,"<NetworkLink>\n");
+    outprintf(&ob,"<name>Live Solutions</name>\n");
+    outprintf(&ob,"<Link><href>%s</href><refreshMode>onInterval</refreshMode>"
+              "<refreshInterval>%.1f</refreshInterval></Link>\n",
+              p?p+1:file,intv);
+    outprintf(&ob,"</NetworkLink>\n");
+    outprintf(&ob,"</kml>\n");
+    stat=closekml(fp,&ob);
+    return stat;
+}
+/* publish snapshot of live solutions ------------------------------------------
+* save snapshot to temporary file <file>.tmp and rename it to the kml file,
+* so the viewer never loads a partly written file
+*-----------------------------------------------------------------------------*/
+static int publive(const kmllive_t *live, solbuf_t *snap)
+{
+    char tmpfile[1036];
+    double dr[3];
+    
+    sprintf(tmpfile,"%s.tmp",live->file);
+    
+    if (!savekml(tmpfile,snap,&live->opt,NULL,
+                 meanoffset(snap,live->opt.offset,dr))) {
+        remove(tmpfile);
+        return 0;
+    }
+#ifdef WIN32
+    if (!MoveFileExA(tmpfile,live->file,MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (rename(tmpfile,live->file)) {
+#endif
+        fprintf(stderr,"file rename error : %s\n",live->file);
+        remove(tmpfile);
+        return 0;
+    }
+    return 1;
+}
+/* take and publish snapshot if updated --------------------------------------*/
+static int snaplive(kmllive_t *live, solbuf_t *snap, int *nsol)
+{
+    int upd,stat=1;
+    
+    lock(&live->lock);
+    if ((upd=live->nsol!=*nsol)) {
+        *nsol=live->nsol;
+        if (!copysolbuf(snap,&live->solbuf)) stat=upd=0;
+    }
+    unlock(&live->lock);
+    
+    if (upd&&snap->n>0) stat=publive(live,snap);
+    return stat;
+}
+/* publisher thread of live kml ------------------------------------------------
+* publish snapshot of live solutions every interval until stop request. the
+* lock is held only to copy the columns, so writing kml never stalls input
+*-----------------------------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI livethread(void *arg)
+#else
+static void *livethread(void *arg)
+#endif
+{
+    kmllive_t *live=(kmllive_t *)arg;
+    solbuf_t snap;
+    uint32_t tick;
+    int nsol=0,stop=0,stat;
+    
+    initsolbuf(&snap,0,0);
+    
+    while (!stop) {
+        for (tick=tickget();;sleepms(10)) {
+            lock(&live->lock);
+            stop=live->stop;
+            unlock(&live->lock);
+            if (stop||(int)(tickget()-tick)>=live->intv) break;
         }
-        if (!(file[i] = (char *)malloc(1024))) {
-            for (i--;i >= 0;i--) free(file[i]);
-            return -4;
+        stat=snaplive(live,&snap,&nsol);
+        
+        if (!stat) {
+            lock(&live->lock);
+            live->stat=0;
+            unlock(&live->lock);
         }
     }
-  
-    for (i = 0;i < nfile;i++) {
-        strcpy(files[i], infile[i]);
-
-        if (!outfile) {
-            if ((p = strrchr(infile[i], '.'))) {
-                strncpy(file[i], infile[i], p - infile[i]);
-                strcpy(file[i] + (p - infile[i]), ".kml");
-            }
-            else sprintf(file[i], "%s.kml", infile);
+    freesolbuf(&snap);
+    return 0;
+}
+/* convert live solutions to google earth kml ----------------------------------
+* read solution lines from live input stream into cyclic solution buffer and
+* publish kml snapshot of latest solutions at interval
+* args   : char   *path     I   input path ("-":stdin,"tcp://host:port":tcp
+*                               client,others:file or fifo)
+*          char   *file     I   output kml file
+*          int    nmax      I   max number of solutions in snapshot
+*          double intv      I   interval of snapshots (s)
+*          kmlopt_t *opt    I   conversion options (NULL: kmlopt_default)
+* return : status (0:ok,-1:input open error,-4:file write)
+* notes  : runs until end of input or disconnect message. the lines are
+*          decoded by inputsol() and snapshots are written by own thread,
+*          see livethread(). <base>_link.kml refreshes the kml in viewer by
+*          network link at the interval. the points are not tiled (tile)
+*-----------------------------------------------------------------------------*/
+extern int convkmllive(const char *path, const char *file, int nmax,
+                       double intv, const kmlopt_t *opt)
+{
+    kmllive_t live;
+    livesrc_t src;
+    solbuf_t snap;
+    thread_t thread;
+    uint8_t buff[MAXLIVEBUF];
+    uint32_t tick;
+    int i,n,disc=0,nsol=0,state,stat;
+    
+    if (!opt) opt=&kmlopt_default;
+    
+    if (!openlive(path,&src)) {
+        fprintf(stderr,"input open error : %s\n",path);
+        return -1;
+    }
+    live.opt=*opt;
+    live.opt.tile=0;
+    live.file=file;
+    live.nsol=live.stop=0;
+    live.intv=(int)(intv*1000.0);
+    live.stat=1;
+    initsolbuf(&live.solbuf,1,nmax+1);
+    initlock(&live.lock);
+    
+    if (!outlivelink(file,intv)) live.stat=0;
+    
+#ifdef WIN32
+    state=(thread=CreateThread(NULL,0,livethread,&live,0,NULL))!=NULL;
+#else
+    state=!pthread_create(&thread,NULL,livethread,&live);
+#endif
+    initsolbuf(&snap,0,0);
+    tick=tickget();
+    
+    while (!disc&&(n=readlive(&src,buff,sizeof(buff)))>0) {
+        lock(&live.lock);
+        for (i=0;i<n;i++) {
+            stat=inputsol(buff[i],opt->ts,opt->te,opt->tint,opt->qflg,
+                          &solopt_default,&live.solbuf);
+            if (stat==1) live.nsol++;
+            else if (stat==-1) {disc=1; break;}
         }
-        else strcpy(file[i], outfile[i]);
-
-        /* read solution file */
-        stat = readsolt(files[i], 1, ts, te, tint, qflg, &solbuf);
-
-        if (!stat) {
-            free(&solbuf); 
+        unlock(&live.lock);
+        
+        /* publish in this thread if no thread created */
+        if (!state&&(int)(tickget()-tick)>=live.intv) {
+            if (!snaplive(&live,&snap,&nsol)) live.stat=0;
+            tick=tickget();
         }
-        else {
-            /* mean position */
-            for (m = 0;m<3;m++) {
-                for (j = 0;j<solbuf.n;j++) rr[m] += solbuf.data[j].rr[m];
-                rr[m] /= solbuf.n;
-            }
-            /* add offset */
-            ecef2pos(rr, pos);
-            enu2ecef(pos, offset, dr);
-            for (m = 0;m<solbuf.n;m++) {
-                for (j = 0;j<3;j++) solbuf.data[m].rr[j] += dr[j];
-            }
-            if (norm(solbuf.rb, 3)>0.0) {
-                for (m = 0;m<3;m++) solbuf.rb[m] += dr[m];
-            }
-            /* save kml file */
-            ret=savekml(file[i], &solbuf, tcolor, pcolor, outalt, outtime);
-            freesolbuf(&solbuf);
-        }  
-        free(files[i]);
-        free(file[i]);
     }
-    return 1;
-}
\ No newline at end of file
+    lock(&live.lock);
+    live.stop=1;
+    unlock(&live.lock);
+    
+    if (state) {
+#ifdef WIN32
+        WaitForSingleObject(thread,INFINITE);
+        CloseHandle(thread);
+#else
+        pthread_join(thread,NULL);
+#endif
+    }
+    else if (!snaplive(&live,&snap,&nsol)) live.stat=0;
+    
+    freesolbuf(&snap);
+    freesolbuf(&live.solbuf);
+    freelock(&live.lock);
+    closelive(&src);
+    return live.stat?0:-4;
+}
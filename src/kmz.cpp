@@ -0,0 +1,601 @@
+/*------------------------------------------------------------------------------
+* kmz.cpp : kmz (zip archive of kml) writer
+*
+* references :
+*     [1] P.Deutsch, DEFLATE Compressed Data Format Specification version 1.3,
+*         RFC 1951, May 1996
+*     [2] PKWARE Inc., APPNOTE.TXT - .ZIP File Format Specification, version
+*         6.3.9, July 15, 2020
+*     [3] M.Adler, pigz - parallel gzip, https://zlib.net/pigz/
+*
+* notes  : the kml is compressed by deflate with fixed huffman codes and lz77
+*          matching by hash chains. as pigz [3], the kml is split to blocks of
+*          MAXKMZBLK bytes compressed independently by a pool of NKMZTHREAD
+*          threads, with the last 32 KB of previous block as dictionary. each
+*          block ends by an empty stored block to align to byte, so the
+*          compressed blocks and the crc-32 of blocks are concatenated in
+*          order by the caller. up to NKMZJOB blocks are queued while the
+*          caller formats the next block. the archive has single entry with
+*          data descriptor, so the file is written sequentially. zip64 is not
+*          supported (max 4 GB)
+*-----------------------------------------------------------------------------*/
+#include "../include/common.h"
+
+/* constants -----------------------------------------------------------------*/
+
+#define WSIZE       32768               /* size of lz77 window */
+#define WMASK       (WSIZE-1)
+#define HBITS       15                  /* bits of hash of 3 bytes */
+#define HSIZE       (1<<HBITS)
+#define MAXCHAIN    16                  /* max length of hash chain searched */
+#define MINMATCH    3                   /* min length of match */
+#define MAXMATCH    258                 /* max length of match */
+#define MAXINSERT   16                  /* max length of match inserted to chains */
+
+static const uint32_t tbl_CRC32[]={ /* crc-32 table (poly=0xEDB88320) */
+    0x00000000,0x77073096,0xEE0E612C,0x990951BA,0x076DC419,0x706AF48F,
+    0xE963A535,0x9E6495A3,0x0EDB8832,0x79DCB8A4,0xE0D5E91E,0x97D2D988,
+    0x09B64C2B,0x7EB17CBD,0xE7B82D07,0x90BF1D91,0x1DB71064,0x6AB020F2,
+    0xF3B97148,0x84BE41DE,0x1ADAD47D,0x6DDDE4EB,0xF4D4B551,0x83D385C7,
+    0x136C9856,0x646BA8C0,0xFD62F97A,0x8A65C9EC,0x14015C4F,0x63066CD9,
+    0xFA0F3D63,0x8D080DF5,0x3B6E20C8,0x4C69105E,0xD56041E4,0xA2677172,
+    0x3C03E4D1,0x4B04D447,0xD20D85FD,0xA50AB56B,0x35B5A8FA,0x42B2986C,
+    0xDBBBC9D6,0xACBCF940,0x32D86CE3,0x45DF5C75,0xDCD60DCF,0xABD13D59,
+    0x26D930AC,0x51DE003A,0xC8D75180,0xBFD06116,0x21B4F4B5,0x56B3C423,
+    0xCFBA9599,0xB8BDA50F,0x2802B89E,0x5F058808,0xC60CD9B2,0xB10BE924,
+    0x2F6F7C87,0x58684C11,0xC1611DAB,0xB6662D3D,0x76DC4190,0x01DB7106,
+    0x98D220BC,0xEFD5102A,0x71B18589,0x06B6B51F,0x9FBFE4A5,0xE8B8D433,
+    0x7807C9A2,0x0F00F934,0x9609A88E,0xE10E9818,0x7F6A0DBB,0x086D3D2D,
+    0x91646C97,0xE6635C01,0x6B6B51F4,0x1C6C6162,0x856530D8,0xF262004E,
+    0x6C0695ED,0x1B01A57B,0x8208F4C1,0xF50FC457,0x65B0D9C6,0x12B7E950,
+    0x8BBEB8EA,0xFCB9887C,0x62DD1DDF,0x15DA2D49,0x8CD37CF3,0xFBD44C65,
+    0x4DB26158,0x3AB551CE,0xA3BC0074,0xD4BB30E2,0x4ADFA541,0x3DD895D7,
+    0xA4D1C46D,0xD3D6F4FB,0x4369E96A,0x346ED9FC,0xAD678846,0xDA60B8D0,
+    0x44042D73,0x33031DE5,0xAA0A4C5F,0xDD0D7CC9,0x5005713C,0x270241AA,
+    0xBE0B1010,0xC90C2086,0x5768B525,0x206F85B3,0xB966D409,0xCE61E49F,
+    0x5EDEF90E,0x29D9C998,0xB0D09822,0xC7D7A8B4,0x59B33D17,0x2EB40D81,
+    0xB7BD5C3B,0xC0BA6CAD,0xEDB88320,0x9ABFB3B6,0x03B6E20C,0x74B1D29A,
+    0xEAD54739,0x9DD277AF,0x04DB2615,0x73DC1683,0xE3630B12,0x94643B84,
+    0x0D6D6A3E,0x7A6A5AA8,0xE40ECF0B,0x9309FF9D,0x0A00AE27,0x7D079EB1,
+    0xF00F9344,0x8708A3D2,0x1E01F268,0x6906C2FE,0xF762575D,0x806567CB,
+    0x196C3671,0x6E6B06E7,0xFED41B76,0x89D32BE0,0x10DA7A5A,0x67DD4ACC,
+    0xF9B9DF6F,0x8EBEEFF9,0x17B7BE43,0x60B08ED5,0xD6D6A3E8,0xA1D1937E,
+    0x38D8C2C4,0x4FDFF252,0xD1BB67F1,0xA6BC5767,0x3FB506DD,0x48B2364B,
+    0xD80D2BDA,0xAF0A1B4C,0x36034AF6,0x41047A60,0xDF60EFC3,0xA867DF55,
+    0x316E8EEF,0x4669BE79,0xCB61B38C,0xBC66831A,0x256FD2A0,0x5268E236,
+    0xCC0C7795,0xBB0B4703,0x220216B9,0x5505262F,0xC5BA3BBE,0xB2BD0B28,
+    0x2BB45A92,0x5CB36A04,0xC2D7FFA7,0xB5D0CF31,0x2CD99E8B,0x5BDEAE1D,
+    0x9B64C2B0,0xEC63F226,0x756AA39C,0x026D930A,0x9C0906A9,0xEB0E363F,
+    0x72076785,0x05005713,0x95BF4A82,0xE2B87A14,0x7BB12BAE,0x0CB61B38,
+    0x92D28E9B,0xE5D5BE0D,0x7CDCEFB7,0x0BDBDF21,0x86D3D2D4,0xF1D4E242,
+    0x68DDB3F8,0x1FDA836E,0x81BE16CD,0xF6B9265B,0x6FB077E1,0x18B74777,
+    0x88085AE6,0xFF0F6A70,0x66063BCA,0x11010B5C,0x8F659EFF,0xF862AE69,
+    0x616BFFD3,0x166CCF45,0xA00AE278,0xD70DD2EE,0x4E048354,0x3903B3C2,
+    0xA7672661,0xD06016F7,0x4969474D,0x3E6E77DB,0xAED16A4A,0xD9D65ADC,
+    0x40DF0B66,0x37D83BF0,0xA9BCAE53,0xDEBB9EC5,0x47B2CF7F,0x30B5FFE9,
+    0xBDBDF21C,0xCABAC28A,0x53B39330,0x24B4A3A6,0xBAD03605,0xCDD70693,
+    0x54DE5729,0x23D967BF,0xB3667A2E,0xC4614AB8,0x5D681B02,0x2A6F2B94,
+    0xB40BBE37,0xC30C8EA1,0x5A05DF1B,0x2D02EF8D
+};
+static const int lbase[]={ /* base of length codes 257-285 */
+    3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,
+    195,227,258
+};
+static const int lext[]={ /* extra bits of length codes 257-285 */
+    0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0
+};
+static const int dbase[]={ /* base of distance codes 0-29 */
+    1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,
+    3073,4097,6145,8193,12289,16385,24577
+};
+static const int dext[]={ /* extra bits of distance codes 0-29 */
+    0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13
+};
+/* crc-32 (slicing by 8 bytes) ----------------------------------------------*/
+static uint32_t crc32(const uint32_t (*tbl)[256], uint32_t crc,
+                      const uint8_t *buff, int len)
+{
+    uint32_t c,d;
+    int i;
+    
+    crc=~crc;
+    for (i=0;i+8<=len;i+=8) {
+        c=crc^((uint32_t)buff[i  ]|(uint32_t)buff[i+1]<<8|
+               (uint32_t)buff[i+2]<<16|(uint32_t)buff[i+3]<<24);
+        d=(uint32_t)buff[i+4]|(uint32_t)buff[i+5]<<8|(uint32_t)buff[i+6]<<16|
+          (uint32_t)buff[i+7]<<24;
+        crc=tbl[7][c&0xFF]^tbl[6][(c>>8)&0xFF]^tbl[5][(c>>16)&0xFF]^
+            tbl[4][c>>24]^tbl[3][d&0xFF]^tbl[2][(d>>8)&0xFF]^
+            tbl[1][(d>>16)&0xFF]^tbl[0][d>>24];
+    }
+    for (;i<len;i++) crc=tbl[0][(crc^buff[i])&0xFF]^(crc>>8);
+    return ~crc;
+}
+/* multiply polynomials modulo crc-32 polynomial (a!=0) ----------------------*/
+static uint32_t multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m=(uint32_t)1<<31,p=0;
+    
+    for (;;) {
+        if (a&m) {
+            p^=b;
+            if (!(a&(m-1))) break;
+        }
+        m>>=1;
+        b=b&1?(b>>1)^0xEDB88320:b>>1;
+    }
+    return p;
+}
+/* combine crc-32 of two blocks ------------------------------------------------
+* crc-32 of concatenated blocks by crc-32 of blocks (crc1,crc2) and length of
+* second block (len2) as crc32_combine() of zlib
+*-----------------------------------------------------------------------------*/
+static uint32_t crc32comb(uint32_t crc1, uint32_t crc2, int len2)
+{
+    uint32_t p=(uint32_t)1<<23,x=(uint32_t)1<<31; /* x^8 (byte), x^0 */
+    
+    for (;len2>0;len2>>=1,p=multmodp(p,p)) {
+        if (len2&1) x=multmodp(p,x);
+    }
+    return multmodp(x,crc1)^crc2;
+}
+/* put bits to compressed data -----------------------------------------------*/
+static void putbits(kmzjob_t *job, uint32_t val, int len)
+{
+    job->bitbuf|=(uint64_t)val<<job->nbit;
+    job->nbit+=len;
+    if (job->nbit>=32) {
+        job->out[job->nout++]=(uint8_t)job->bitbuf;
+        job->out[job->nout++]=(uint8_t)(job->bitbuf>>8);
+        job->out[job->nout++]=(uint8_t)(job->bitbuf>>16);
+        job->out[job->nout++]=(uint8_t)(job->bitbuf>>24);
+        job->bitbuf>>=32;
+        job->nbit-=32;
+    }
+}
+/* flush whole bytes in bit buffer -------------------------------------------*/
+static void flushbits(kmzjob_t *job)
+{
+    for (;job->nbit>=8;job->nbit-=8) {
+        job->out[job->nout++]=(uint8_t)job->bitbuf;
+        job->bitbuf>>=8;
+    }
+}
+/* index of code by base -----------------------------------------------------*/
+static int basecode(const int *base, int n, int val)
+{
+    int i=0,j=n-1,k;
+    
+    while (i<j) {
+        k=(i+j+1)/2;
+        if (base[k]<=val) i=k; else j=k-1;
+    }
+    return i;
+}
+/* set code tables of fixed huffman codes ------------------------------------*/
+static void initcodes(kmz_t *kmz)
+{
+    uint32_t code,rev;
+    int i,j,len;
+    
+    for (i=0;i<288;i++) {
+        if      (i<144) {code=0x30+i;        len=8;}
+        else if (i<256) {code=0x190+i-144;   len=9;}
+        else if (i<280) {code=i-256;         len=7;}
+        else            {code=0xC0+i-280;    len=8;}
+        for (j=0,rev=0;j<len;j++) rev|=((code>>j)&1)<<(len-1-j); /* msb first */
+        kmz->hcode[i]=(uint16_t)rev;
+        kmz->hlen[i]=(uint8_t)len;
+    }
+    for (i=0;i<256;i++) {
+        kmz->lsym[i]=(uint8_t)basecode(lbase,29,i+3);
+        kmz->dsym[i]=(uint8_t)basecode(dbase,30,i+1);
+        kmz->dsym[256+i]=(uint8_t)basecode(dbase,30,(i<<7)+1);
+    }
+    for (i=0;i<30;i++) {
+        for (j=0,rev=0;j<5;j++) rev|=((i>>j)&1)<<(4-j);
+        kmz->dcode[i]=(uint8_t)rev;
+    }
+    for (i=0;i<256;i++) { /* crc-32 tables of slices */
+        kmz->crctbl[0][i]=tbl_CRC32[i];
+        for (j=1;j<8;j++) {
+            code=kmz->crctbl[j-1][i];
+            kmz->crctbl[j][i]=(code>>8)^tbl_CRC32[code&0xFF];
+        }
+    }
+}
+/* distance code of distance -------------------------------------------------*/
+static int distsym(const kmz_t *kmz, int dist)
+{
+    return dist<=256?kmz->dsym[dist-1]:kmz->dsym[256+((dist-1)>>7)];
+}
+/* put match of length and distance ------------------------------------------*/
+static void putmatch(const kmz_t *kmz, kmzjob_t *job, int len, int dist)
+{
+    int c=kmz->lsym[len-3];
+    
+    putbits(job,kmz->hcode[257+c],kmz->hlen[257+c]);
+    if (lext[c]) putbits(job,len-lbase[c],lext[c]);
+    
+    c=distsym(kmz,dist);
+    putbits(job,kmz->dcode[c],5);
+    if (dext[c]) putbits(job,dist-dbase[c],dext[c]);
+}
+/* length of match -----------------------------------------------------------*/
+static int matchlen(const uint8_t *p, const uint8_t *q, int max)
+{
+    uint64_t a,b;
+    int len=0;
+    
+    for (;len+8<=max;len+=8) { /* compare by 8 bytes */
+        memcpy(&a,p+len,8);
+        memcpy(&b,q+len,8);
+        if (a!=b) break;
+    }
+    for (;len<max&&p[len]==q[len];len++) ;
+    return len;
+}
+/* hash of 3 bytes -----------------------------------------------------------*/
+static int hash3(const uint8_t *p)
+{
+    return (int)((((uint32_t)p[0]<<16|(uint32_t)p[1]<<8|p[2])*2654435761U)>>
+                 (32-HBITS));
+}
+/* compress block of job -------------------------------------------------------
+* compress block of kml by a deflate block with fixed huffman codes followed
+* by an empty stored block to align the compressed data to byte
+* args   : kmz_t  *kmz      I   kmz writer (code tables)
+*          kmzjob_t *job    IO  job (win,ndict,nblk: block, out,nout,crc:
+*                               compressed data and crc-32 of block)
+* return : none
+* notes  : the dictionary is only inserted to the hash chains and matches
+*          may refer it. the window of a job is not slid, so the slot p&WMASK
+*          of prev[] is valid for the positions within WSIZE from p. as the
+*          fast levels of zlib, the positions in a match longer than MAXINSERT
+*          are not inserted to the hash chains
+*-----------------------------------------------------------------------------*/
+static void deflatejob(const kmz_t *kmz, kmzjob_t *job)
+{
+    const uint8_t *w=job->win;
+    int *head=job->head,*prev=job->prev;
+    int i,p,end=job->ndict+job->nblk,h,cand,len,blen,bdist,chain;
+    
+    job->nout=0;
+    job->bitbuf=0;
+    job->nbit=0;
+    for (i=0;i<HSIZE;i++) head[i]=-1;
+    
+    /* dictionary to hash chains */
+    for (p=0;p<job->ndict&&end-p>=MINMATCH;p++) {
+        h=hash3(w+p);
+        prev[p&WMASK]=head[h];
+        head[h]=p;
+    }
+    p=job->ndict;
+    
+    putbits(job,0,1); /* bfinal=0 */
+    putbits(job,1,2); /* btype=01 (fixed huffman) */
+    
+    while (p<end) {
+        blen=0; bdist=0;
+        if (end-p>=MINMATCH) {
+            h=hash3(w+p);
+            for (cand=head[h],chain=0;cand>=0&&p-cand<=WSIZE&&chain<MAXCHAIN;
+                 cand=prev[cand&WMASK],chain++) {
+                if (w[cand+blen]!=w[p+blen]) continue;
+                len=matchlen(w+cand,w+p,end-p<MAXMATCH?end-p:MAXMATCH);
+                if (len>blen) {
+                    blen=len; bdist=p-cand;
+                    if (len>=MAXMATCH||p+len>=end) break;
+                }
+            }
+        }
+        if (blen>=MINMATCH) {
+            putmatch(kmz,job,blen,bdist);
+        }
+        else {
+            putbits(job,kmz->hcode[w[p]],kmz->hlen[w[p]]);
+            blen=1;
+        }
+        /* insert positions to hash chains (first position of long match) */
+        for (i=0;i<blen;i++,p++) {
+            if (i>0&&blen>MAXINSERT) {
+                p+=blen-i;
+                break;
+            }
+            if (end-p<MINMATCH) continue;
+            h=hash3(w+p);
+            prev[p&WMASK]=head[h];
+            head[h]=p;
+        }
+    }
+    putbits(job,kmz->hcode[256],kmz->hlen[256]); /* end of block */
+    
+    /* empty stored block (bfinal=0,btype=00,len=0,nlen=0xFFFF) */
+    putbits(job,0,3);
+    if (job->nbit&7) putbits(job,0,8-(job->nbit&7));
+    putbits(job,0xFFFF0000u,32);
+    flushbits(job);
+    
+    job->crc=crc32(kmz->crctbl,0,w+job->ndict,job->nblk);
+}
+/* compression thread --------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI kmzthread(void *arg)
+#else
+static void *kmzthread(void *arg)
+#endif
+{
+    kmz_t *kmz=(kmz_t *)arg;
+    kmzjob_t *job;
+    
+    for (;;) {
+        lock(&kmz->lock);
+        while (kmz->nexe>=kmz->nsub&&!kmz->stop) waitcond(&kmz->cond,&kmz->lock);
+        if (kmz->nexe>=kmz->nsub) {
+            unlock(&kmz->lock);
+            break;
+        }
+        job=kmz->job+kmz->nexe++%NKMZJOB;
+        unlock(&kmz->lock);
+        
+        deflatejob(kmz,job);
+        
+        lock(&kmz->lock);
+        job->done=1;
+        broadcastcond(&kmz->cond);
+        unlock(&kmz->lock);
+    }
+    return 0;
+}
+/* submit job of filled block ------------------------------------------------*/
+static void submitjob(kmz_t *kmz)
+{
+    kmzjob_t *job=kmz->job+kmz->nsub%NKMZJOB;
+    
+    job->done=0;
+    if (kmz->nthread<=0) { /* no thread */
+        deflatejob(kmz,job);
+        job->done=1;
+        kmz->nsub++;
+        return;
+    }
+    lock(&kmz->lock);
+    kmz->nsub++;
+    broadcastcond(&kmz->cond);
+    unlock(&kmz->lock);
+}
+/* write compressed data of oldest job ---------------------------------------*/
+static void writejob(kmz_t *kmz)
+{
+    kmzjob_t *job=kmz->job+kmz->nwrt%NKMZJOB;
+    
+    if (kmz->nthread>0) {
+        lock(&kmz->lock);
+        while (!job->done) waitcond(&kmz->cond,&kmz->lock);
+        unlock(&kmz->lock);
+    }
+    if (fwrite(job->out,1,job->nout,kmz->fp)<(size_t)job->nout) kmz->stat=0;
+    kmz->crc=crc32comb(kmz->crc,job->crc,job->nblk);
+    kmz->usize+=job->nblk;
+    kmz->csize+=job->nout;
+    kmz->nwrt++;
+}
+/* submit filled block and start next block ----------------------------------*/
+static void nextjob(kmz_t *kmz)
+{
+    kmzjob_t *job=kmz->job+kmz->nsub%NKMZJOB,*next;
+    int n=job->ndict+job->nblk;
+    
+    submitjob(kmz);
+    if (kmz->nsub-kmz->nwrt>=NKMZJOB) writejob(kmz);
+    
+    /* last WSIZE bytes of block as dictionary of next block */
+    next=kmz->job+kmz->nsub%NKMZJOB;
+    next->ndict=n<WSIZE?n:WSIZE;
+    next->nblk=0;
+    memcpy(next->win,job->win+n-next->ndict,next->ndict);
+}
+/* free jobs -----------------------------------------------------------------*/
+static void freejobs(kmz_t *kmz)
+{
+    int i;
+    
+    for (i=0;i<NKMZJOB;i++) {
+        free(kmz->job[i].win); free(kmz->job[i].out);
+        free(kmz->job[i].head); free(kmz->job[i].prev);
+    }
+}
+/* put little-endian integers to header --------------------------------------*/
+static uint8_t *setu2(uint8_t *p, uint32_t val)
+{
+    p[0]=(uint8_t)val; p[1]=(uint8_t)(val>>8);
+    return p+2;
+}
+static uint8_t *setu4(uint8_t *p, uint32_t val)
+{
+    p[0]=(uint8_t)val; p[1]=(uint8_t)(val>>8);
+    p[2]=(uint8_t)(val>>16); p[3]=(uint8_t)(val>>24);
+    return p+4;
+}
+/* zip file header -------------------------------------------------------------
+* local file header (central=0) or central directory header (central=1)
+*-----------------------------------------------------------------------------*/
+static int zipheader(const kmz_t *kmz, int central, uint8_t *buff)
+{
+    uint8_t *p=buff;
+    int n=(int)strlen(kmz->name);
+    
+    p=setu4(p,central?0x02014B50:0x04034B50); /* signature */
+    if (central) p=setu2(p,20);         /* version made by */
+    p=setu2(p,20);                      /* version needed (2.0: deflate) */
+    p=setu2(p,0x0008);                  /* flags (data descriptor) */
+    p=setu2(p,8);                       /* method (deflate) */
+    p=setu2(p,kmz->dostime);            /* last mod time */
+    p=setu2(p,kmz->dosdate);            /* last mod date */
+    p=setu4(p,central?kmz->crc:0);      /* crc-32 */
+    p=setu4(p,central?(uint32_t)kmz->csize:0); /* compressed size */
+    p=setu4(p,central?(uint32_t)kmz->usize:0); /* uncompressed size */
+    p=setu2(p,n);                       /* file name length */
+    p=setu2(p,0);                       /* extra field length */
+    if (central) {
+        p=setu2(p,0);                   /* file comment length */
+        p=setu2(p,0);                   /* disk number start */
+        p=setu2(p,0);                   /* internal file attributes */
+        p=setu4(p,0);                   /* external file attributes */
+        p=setu4(p,0);                   /* offset of local header */
+    }
+    memcpy(p,kmz->name,n);
+    return (int)(p-buff)+n;
+}
+/* open kmz writer -------------------------------------------------------------
+* open kmz writer and start compression threads
+* args   : kmz_t  *kmz      O   kmz writer
+*          FILE   *fp       I   output file (opened by "wb" and empty)
+*          char   *name     I   name of kml in archive (as "doc.kml")
+* return : status (1:ok,0:error)
+* notes  : the file is not closed by closekmz(). if no thread is started, the
+*          blocks are compressed by the caller
+*-----------------------------------------------------------------------------*/
+extern int openkmz(kmz_t *kmz, FILE *fp, const char *name)
+{
+    kmzjob_t *job;
+    uint8_t buff[512];
+    time_t t=time(NULL);
+    struct tm *tt=localtime(&t);
+    int i,n;
+    
+    memset(kmz,0,sizeof(kmz_t));
+    kmz->fp=fp;
+    kmz->stat=1;
+    sprintf(kmz->name,"%.255s",name);
+    if (tt) {
+        kmz->dostime=(uint16_t)(tt->tm_hour<<11|tt->tm_min<<5|tt->tm_sec/2);
+        kmz->dosdate=(uint16_t)((tt->tm_year-80)<<9|(tt->tm_mon+1)<<5|tt->tm_mday);
+    }
+    initcodes(kmz);
+    
+    for (i=0;i<NKMZJOB;i++) {
+        job=kmz->job+i;
+        job->win =(uint8_t *)malloc(WSIZE+MAXKMZBLK);
+        job->out =(uint8_t *)malloc(MAXKMZBLK+MAXKMZBLK/8+64);
+        job->head=(int *)malloc(sizeof(int)*HSIZE);
+        job->prev=(int *)malloc(sizeof(int)*WSIZE);
+        if (!job->win||!job->out||!job->head||!job->prev) {
+            fprintf(stderr,"kmz memory allocation error\n");
+            freejobs(kmz);
+            return 0;
+        }
+    }
+    n=zipheader(kmz,0,buff);
+    if (fwrite(buff,1,n,fp)<(size_t)n) kmz->stat=0;
+    kmz->offset=n;
+    
+    initlock(&kmz->lock);
+    initcond(&kmz->cond);
+    for (i=0;i<NKMZTHREAD;i++) {
+#ifdef WIN32
+        if (!(kmz->thread[kmz->nthread]=CreateThread(NULL,0,kmzthread,kmz,0,
+                                                     NULL))) break;
+#else
+        if (pthread_create(kmz->thread+kmz->nthread,NULL,kmzthread,kmz)) break;
+#endif
+        kmz->nthread++;
+    }
+    return 1;
+}
+/* write kml to kmz writer -----------------------------------------------------
+* append kml to block and pass filled blocks to compression threads
+* args   : kmz_t  *kmz      IO  kmz writer
+*          char   *buff     I   kml data
+*          int    n         I   length of kml data (bytes)
+* return : status (1:ok,0:error)
+* notes  : the data is copied and compressed while the caller formats next
+*          blocks. it waits for the compression of the oldest block if
+*          NKMZJOB blocks are queued
+*-----------------------------------------------------------------------------*/
+extern int writekmz(kmz_t *kmz, const char *buff, int n)
+{
+    kmzjob_t *job;
+    int m;
+    
+    for (;n>0;buff+=m,n-=m) {
+        job=kmz->job+kmz->nsub%NKMZJOB;
+        m=MAXKMZBLK-job->nblk<n?MAXKMZBLK-job->nblk:n;
+        memcpy(job->win+job->ndict+job->nblk,buff,m);
+        job->nblk+=m;
+        if (job->nblk>=MAXKMZBLK) nextjob(kmz);
+    }
+    return kmz->stat;
+}
+/* close kmz writer ------------------------------------------------------------
+* compress last block, stop compression threads and write end of archive
+* args   : kmz_t  *kmz      IO  kmz writer
+* return : status (1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int closekmz(kmz_t *kmz)
+{
+    kmzjob_t fin={0};
+    uint8_t buff[512],*p;
+    uint64_t off;
+    int i,n;
+    
+    if (kmz->job[kmz->nsub%NKMZJOB].nblk>0) submitjob(kmz);
+    while (kmz->nwrt<kmz->nsub) writejob(kmz);
+    
+    if (kmz->nthread>0) {
+        lock(&kmz->lock);
+        kmz->stop=1;
+        broadcastcond(&kmz->cond);
+        unlock(&kmz->lock);
+    }
+    for (i=0;i<kmz->nthread;i++) {
+#ifdef WIN32
+        WaitForSingleObject(kmz->thread[i],INFINITE);
+        CloseHandle(kmz->thread[i]);
+#else
+        pthread_join(kmz->thread[i],NULL);
+#endif
+    }
+    freelock(&kmz->lock);
+    freecond(&kmz->cond);
+    
+    /* final empty block */
+    fin.out=buff;
+    putbits(&fin,1,1); /* bfinal=1 */
+    putbits(&fin,1,2); /* btype=01 */
+    putbits(&fin,kmz->hcode[256],kmz->hlen[256]);
+    if (fin.nbit&7) putbits(&fin,0,8-(fin.nbit&7));
+    flushbits(&fin);
+    if (fwrite(buff,1,fin.nout,kmz->fp)<(size_t)fin.nout) kmz->stat=0;
+    kmz->csize+=fin.nout;
+    
+    if (kmz->usize>=0xFFFFFFFFu||kmz->csize>=0xFFFFFFFFu) {
+        fprintf(stderr,"kmz size over 4 GB not supported\n");
+        kmz->stat=0;
+    }
+    /* data descriptor */
+    p=buff;
+    p=setu4(p,0x08074B50);
+    p=setu4(p,kmz->crc);
+    p=setu4(p,(uint32_t)kmz->csize);
+    p=setu4(p,(uint32_t)kmz->usize);
+    off=kmz->offset+kmz->csize+16;
+    
+    /* central directory and end of central directory record */
+    n=zipheader(kmz,1,p);
+    p+=n;
+    p=setu4(p,0x06054B50);
+    p=setu2(p,0);                       /* number of this disk */
+    p=setu2(p,0);                       /* disk of central directory */
+    p=setu2(p,1);                       /* entries on this disk */
+    p=setu2(p,1);                       /* total entries */
+    p=setu4(p,n);                       /* size of central directory */
+    p=setu4(p,(uint32_t)off);           /* offset of central directory */
+    p=setu2(p,0);                       /* comment length */
+    
+    if (fwrite(buff,1,p-buff,kmz->fp)<(size_t)(p-buff)) kmz->stat=0;
+    
+    freejobs(kmz);
+    return kmz->stat;
+}
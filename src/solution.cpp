@@ -57,6 +57,7 @@
 #include <ctype.h>
 #include "../include/common.h"
 #include<math.h>
+#include <sys/stat.h>
 
 /* constants and macros ------------------------------------------------------*/
 
@@ -69,40 +70,234 @@
 
 #define KNOT2M     0.514444444  /* m/knot */
 #define MAXFIELD   64           /* max number of fields in a record */
+#define MAXSOLBLK  (1<<20)      /* block size for reading solution file (bytes) */
+#define MAXRDTHREAD 64          /* max number of parse threads per file */
+#define MINRDRANGE (4<<20)      /* min size of range parsed by a thread (bytes) */
+#define MAXSORTRUN 256          /* max number of sorted runs merged by sort */
+#define WEEKTICKS  ((int64_t)604800*(int64_t)TICKS) /* ticks of a week */
+#define CACHEID    "SOLCACHE"   /* identifier of solution cache file */
+#define CACHEVER   1            /* version of solution cache file */
+#define CACHEEXT   ".solc"      /* extension of solution cache file */
+#ifndef S_ISREG
+#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
+#define CACHEHASH  65536        /* bytes of head/tail of source hashed */
+#define INDEXID    "SOLINDEX"   /* identifier of time index file */
+#define INDEXEXT   ".soli"      /* extension of time index file */
+#define INDEXSTEP  4096         /* number of lines per entry of time index */
+#define SUMBLK     256          /* block of solutions summed for mean position */
 
 
-/* decode lat/lon/height -----------------------------------------------------*/
-static int decode_custom(char *buff, const solopt_t *opt, sol_t *sol)
-{
-    double pos[3] = { 0 }, val[MAXFIELD] = {0},std[3] = { 0 };
-    int flag = 0;
-    double dop=0.0;
-    double utctime = 0.0;
-    double t = 0.0;
+/* type definitions ----------------------------------------------------------*/
 
-    sscanf(buff, "%lf  %lf  %lf  %lf  %lf  %lf  %lf   %d %lf", &utctime, 
-        val, val + 1, val + 2, val+3, val + 4, val + 5, &flag, &dop);
+typedef struct {        /* line reader status type */
+    int line;           /* number of lines */
+    int nsol;           /* number of solutions received */
+    int nerr;           /* number of invalid lines */
+    int lerr;           /* line number of first invalid line */
+    int nscr;           /* number of solutions screened out by filter */
+    uint64_t byte;      /* bytes of file read */
+    int skip;           /* skip rest of too long line */
+    int stop;           /* stop reading */
+    int merr;           /* memory allocation error (0:no,1:yes) */
+    int (*func)(const sol_t *, void *); /* callback (NULL: add to buffer) */
+    void *arg;          /* argument of callback */
+    int64_t *range;     /* range of file {start,end} (bytes) (NULL: all) */
+} rdstat_t;
 
-    pos[0] = val[0] * D2R; /* lat/lon/hgt (ddd.ddd) */
-    pos[1] = val[1] * D2R;
-    pos[2] = val[2];
+typedef struct {        /* solution cache header type */
+    char id[8];         /* identifier (CACHEID) */
+    uint32_t ver;       /* version (CACHEVER) */
+    uint32_t bom;       /* byte order mark (0x01020304) */
+    uint64_t size;      /* size of source file (bytes) */
+    int64_t mtime;      /* modification time of source file (s) */
+    uint64_t hash;      /* hash of head and tail of source file */
+    int64_t n;          /* number of solutions */
+    int32_t line;       /* number of lines */
+    int32_t nerr;       /* number of invalid lines */
+    int32_t lerr;       /* line number of first invalid line */
+    uint32_t flag;      /* flags (time index: 1:sorted by time) */
+} solcache_t;           /* 64 bytes, followed by columns t,lat,lon,h,stat */
+                        /* (time index: followed by entries) */
 
-    sol->time.time = (__int64)(utctime);
-    sol->time.sec =  utctime-sol->time.time;
-    pos2ecef(pos, sol->rr);
+typedef struct {        /* time index entry type */
+    int64_t t;          /* time of first solution of lines (ticks) */
+    int64_t off;        /* offset of first line (bytes) */
+    int64_t line;       /* number of lines before first line */
+} solidx_t;
 
-    sol->stat = (uint8_t)val[6];
+typedef struct {        /* sort key type */
+    int64_t t;          /* time (ticks) */
+    int i;              /* index of solution */
+} solkey_t;
 
-    return 1;
+typedef struct {        /* range parse job type */
+    const char *buff,*end; /* range of lines */
+    const solfilt_t *filt; /* solution filter */
+    const solopt_t *opt; /* solution options */
+    rdstat_t rs;        /* line reader status */
+    solbuf_t solbuf;    /* private solution buffer */
+    int thread;         /* decoded by own thread (0:no,1:yes) */
+} rdjob_t;
+
+const rdopt_t rdopt_default={ /* defaults solution read options */
+    1,1,0,0,NULL,NULL,0,NULL    /* mmap,nthread,cache,index,arena,stat,mean, */
+                                /* rdbuf */
+};
+
+/* compile solution filter ---------------------------------------------------
+* compile screening of time and quality flag to integer comparisons of ticks
+* args   : solfilt_t *filt  O  solution filter
+*          gtime_t ts       I  start time (ts.time==0: from start)
+*          gtime_t te       I  end time   (te.time==0: to end)
+*          double tint      I  time interval (0: all)
+*          int    qflag     I  quality flag  (0: all)
+* return : none
+* notes  : same screening as screent() with tolerance DTTOL. the time interval
+*          is compared by ticks if it is a multiple of 1/TICKS s (as 1 s or
+*          0.5 s), otherwise by screent()
+*-----------------------------------------------------------------------------*/
+static void initfilt(solfilt_t *filt, gtime_t ts, gtime_t te, double tint,
+                     int qflag)
+{
+    const double gpst0[] = { 1980,1,6,0,0,0 }; /* gps time reference */
+    double tt = tint*TICKS;
+
+    filt->ts = ts.time == 0 ? INT64_MIN : (int64_t)ts.time*(int64_t)TICKS +
+               (int64_t)ceil((ts.sec - DTTOL)*TICKS);
+    filt->te = te.time == 0 ? INT64_MAX : (int64_t)te.time*(int64_t)TICKS +
+               (int64_t)ceil((te.sec + DTTOL)*TICKS);
+    if (tint <= 0.0) filt->tint = 0;
+    else if (tt == floor(tt) && tt < 1E18) filt->tint = (int64_t)tt;
+    else filt->tint = -1;
+    filt->tol = (int64_t)floor(DTTOL*TICKS);
+    filt->t0 = time2tick(epoch2time(gpst0));
+    filt->dint = tint;
+    filt->qflag = qflag;
+    filt->gts = ts;
+    filt->gte = te;
+    filt->valid = 1;
+}
+/* test solution filter compiled by same conditions --------------------------*/
+static int samefilt(const solfilt_t *filt, gtime_t ts, gtime_t te, double tint,
+                    int qflag)
+{
+    return filt->valid && filt->gts.time == ts.time && filt->gts.sec == ts.sec &&
+           filt->gte.time == te.time && filt->gte.sec == te.sec &&
+           filt->dint == tint && filt->qflag == qflag;
+}
+/* test solution filter --------------------------------------------------------
+* args   : solfilt_t *filt  I  solution filter
+*          int64_t t        I  time of solution (ticks)
+*          int    stat      I  solution status
+* return : status (1:pass,0:screened out)
+*-----------------------------------------------------------------------------*/
+static int testfilt(const solfilt_t *filt, int64_t t, int stat)
+{
+    gtime_t t0 = { 0 };
+    int64_t r;
+
+    if (t < filt->ts || t >= filt->te) return 0;
+    if (filt->qflag && stat != filt->qflag) return 0;
+    if (filt->tint > 0) {
+        if ((r = (t - filt->t0) % WEEKTICKS) < 0) r += WEEKTICKS; /* tow */
+        r %= filt->tint;
+        return r <= filt->tol || r >= filt->tint - filt->tol;
+    }
+    return filt->tint == 0 || screent(tick2time(t), t0, t0, filt->dint);
+}
+/* decode number field ---------------------------------------------------------
+* decode a decimal number field without sscanf() or strtod()
+* args   : const char *p    I  field (leading blanks are skipped)
+*          const char *end  I  end of line
+*          double *val      O  decoded value
+* return : pointer after the field (NULL: no number or invalid field)
+* notes  : numbers with up to 19 significant digits and no exponent are
+*          converted by one correctly rounded division by an exact power of
+*          10 (Clinger's fast path), which gives the same value as strtod().
+*          other forms (many digits, exponent, nan, inf) fall back to strtod()
+*-----------------------------------------------------------------------------*/
+static const char *decode_num(const char *p, const char *end, double *val)
+{
+    static const double pow10[]={
+        1E0,1E1,1E2,1E3,1E4,1E5,1E6,1E7,1E8,1E9,1E10,1E11,1E12,1E13,1E14,1E15,
+        1E16,1E17,1E18,1E19,1E20,1E21,1E22
+    };
+    const char *q;
+    char buff[64],*s;
+    uint64_t m=0;
+    int neg=0,nd=0,nf=0,ni=0;
+
+    while (p<end&&(*p==' '||*p=='\t')) p++;
+    q=p;
+    if (q<end&&(*q=='-'||*q=='+')) neg=*q++=='-';
+    for (;q<end&&'0'<=*q&&*q<='9';q++,ni++) {
+        if (m||*q!='0') {m=m*10+(*q-'0'); nd++;}
+    }
+    if (q<end&&*q=='.') {
+        for (q++;q<end&&'0'<=*q&&*q<='9';q++,nf++) {
+            if (m||*q!='0') {m=m*10+(*q-'0'); nd++;}
+        }
+    }
+    if ((ni||nf)&&nd<=19&&nf<=22&&m<=(1ULL<<53)&&
+        (q>=end||*q==' '||*q=='\t')) {
+        *val=nf?(double)m/pow10[nf]:(double)m;
+        if (neg) *val=-*val;
+        return q;
+    }
+    /* fallback to strtod() */
+    for (q=p;q<end&&*q!=' '&&*q!='\t';q++) ;
+    if (q==p||q-p>=(int)sizeof(buff)) return NULL;
+    memcpy(buff,p,q-p);
+    buff[q-p]='\0';
+    *val=strtod(buff,&s);
+    return s==buff+(q-p)?q:NULL;
 }
+/* decode custom solution record -------------------------------------------------
+* decode solution record of custom format:
+*   utc-time lat(deg) lon(deg) height(m) sdn(m) sde(m) sdu(m) flag dop
+* return : status (1:ok,2:screened out by filter,-1:invalid record)
+* notes  : the filter is tested just after the time field. the flag is not
+*          mapped to solution status, so status 0 is tested for qflag
+*-----------------------------------------------------------------------------*/
+static int decode_custom(const char *buff, int n, const solopt_t *opt,
+                         const solfilt_t *filt, sol_t *sol)
+{
+    const char *p = buff, *end = buff + n;
+    double val[9], pos[3];
+    int i;
+
+    if (!(p = decode_num(p, end, val))) return -1;
+
+    sol->time.time = (time_t)val[0];
+    sol->time.sec = val[0] - sol->time.time;
+
+    if (filt && !testfilt(filt, time2tick(sol->time), 0)) return 2;
 
+    for (i = 1;i < 9;i++) {
+        if (!(p = decode_num(p, end, val + i))) return -1;
+    }
+    if (val[7] != (int)val[7]) return -1; /* flag */
+
+    pos[0] = val[1] * D2R; /* lat/lon/hgt (ddd.ddd) */
+    pos[1] = val[2] * D2R;
+    pos[2] = val[3];
 
+    sol->rr[0] = pos[0]; /* kept geodetic without transformation to ecef */
+    sol->rr[1] = pos[1];
+    sol->rr[2] = pos[2];
+    sol->type = 2;
+
+    sol->stat = 0; /* flag is not mapped to solution status */
+
+    return 1;
+}
 
 /* decode solution position --------------------------------------------------*/
-static int decode_solpos(char *buff, const solopt_t *opt, sol_t *sol)
+static int decode_solpos(const char *buff, int n, const solopt_t *opt, sol_t *sol)
 {
     sol_t sol0 = { { 0 } };
-    char *p = buff;
+    const char *p = buff;
 
 
     //trace(4, "decode_solpos: buff=%s\n", buff);
@@ -115,14 +310,26 @@ static int decode_solpos(char *buff, const solopt_t *opt, sol_t *sol)
     }*/
     /* decode solution position */
   
-    return decode_custom(p, opt, sol);  //by xdx 2021/1/14
+    return decode_custom(p, n, opt, NULL, sol);  //by xdx 2021/1/14
     
    
 }
 
-/* decode solution -----------------------------------------------------------*/
-static int decode_sol(char *buff, const solopt_t *opt, sol_t *sol, double *rb)
+/* decode solution -------------------------------------------------------------
+* decode solution line
+* args   : const char *buff I  line (not need to be terminated by '\0')
+*          int    n         I  length of line (bytes)
+*          solopt_t *opt    I  solution options
+*          solfilt_t *filt  I  solution filter (NULL: no filter)
+*          sol_t  *sol      O  solution
+*          double *rb       IO reference position
+* return : status (1:ok,0:blank or comment line,2:screened out by filter,
+*                  -1:invalid line)
+*-----------------------------------------------------------------------------*/
+static int decode_sol(const char *buff, int n, const solopt_t *opt,
+                      const solfilt_t *filt, sol_t *sol, double *rb)
 {
+    const char *p = buff, *end = buff + n;
 
 #if 0
     char *p;
@@ -145,27 +352,11 @@ static int decode_sol(char *buff, const solopt_t *opt, sol_t *sol, double *rb)
     return decode_solpos(buff, opt, sol);
 #endif
 
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
 
-    double pos[3] = { 0 }, val[MAXFIELD] = { 0 }, std[3] = { 0 };
-    int flag = 0;
-    double dop = 0.0;
-    double utctime = 0.0;
-    double t = 0.0;
+    if (p >= end || *p == COMMENTH[0]) return 0;
 
-    sscanf(buff, "%lf  %lf  %lf  %lf  %lf  %lf  %lf   %d %lf", &utctime,
-        val, val + 1, val + 2, val + 3, val + 4, val + 5, &flag, &dop);
-
-    pos[0] = val[0] * D2R; /* lat/lon/hgt (ddd.ddd) */
-    pos[1] = val[1] * D2R;
-    pos[2] = val[2];
-
-    sol->time.time = (__int64)(utctime);
-    sol->time.sec = utctime - sol->time.time;
-    pos2ecef(pos, sol->rr);
-
-    sol->stat = (uint8_t)val[6];
-
-    return 1;
+    return decode_custom(p, (int)(end - p), opt, filt, sol);
 }
 /* decode solution options ---------------------------------------------------*/
 static void decode_solopt(char *buff, solopt_t *opt)
@@ -222,19 +413,212 @@ static void readsolopt(FILE *fp, solopt_t *opt)
     }
 }
 
+/* initialize arena of solution columns ----------------------------------------
+* reserve address space of columns for MAXARENASOL solutions
+* args   : solarena_t *arena O  arena of solution columns
+*          int    huge      I  back by huge pages (0:off,1:on)
+* return : status (1:ok,0:error)
+* notes  : the solution buffer with arena (solbuf->arena) grows the columns
+*          by committing segments of arena in place, so the solutions are
+*          never copied by growth and the columns are still contiguous. the
+*          arena is reused by the next solution buffer after freesolbuf().
+*          freesolbuf() decommits the memory of each column above ARENAKEEP
+*          bytes. the extra data column is reserved on the first use
+*-----------------------------------------------------------------------------*/
+extern int initsolarena(solarena_t *arena, int huge)
+{
+    static const size_t size[] = {
+        sizeof(int64_t), sizeof(double), sizeof(double), sizeof(double),
+        sizeof(uint8_t)
+    };
+    int i;
+
+    memset(arena, 0, sizeof(solarena_t));
+    for (i = 0;i < 5;i++) {
+        if (!initarena(arena->col + i, size[i] * MAXARENASOL, huge)) {
+            freesolarena(arena);
+            return 0;
+        }
+    }
+    arena->col[5].huge = huge;
+    return 1;
+}
+/* free arena of solution columns --------------------------------------------*/
+extern void freesolarena(solarena_t *arena)
+{
+    int i;
+
+    for (i = 0;i < 6;i++) freearena(arena->col + i);
+    arena->inuse = 0;
+}
+/* committed memory of arena of solution columns -----------------------------*/
+extern size_t solarenamem(const solarena_t *arena)
+{
+    size_t size = 0;
+    int i;
+
+    for (i = 0;i < 6;i++) size += arena->col[i].used;
+    return size;
+}
+/* allocate extra data column ------------------------------------------------*/
+static int allocext(solbuf_t *solbuf)
+{
+    arena_t *col;
+
+    if (!solbuf->arena) {
+        solbuf->ext = (solext_t *)calloc(solbuf->nmax, sizeof(solext_t));
+        return solbuf->ext != NULL;
+    }
+    col = solbuf->arena->col + 5;
+    if (!col->base && !initarena(col, sizeof(solext_t)*MAXARENASOL, col->huge)) {
+        return 0;
+    }
+    if (!(solbuf->ext = (solext_t *)growarena(col, sizeof(solext_t)*solbuf->nmax))) {
+        return 0;
+    }
+    memset(solbuf->ext, 0, sizeof(solext_t)*solbuf->nmax);
+    return 1;
+}
+/* resize columns of solution buffer in arena --------------------------------*/
+static int resizearena(solbuf_t *solbuf, int nmax)
+{
+    arena_t *col = solbuf->arena->col;
+    int i;
+
+    if (nmax <= solbuf->nmax) return 1; /* not shrunk */
+    if (nmax > MAXARENASOL) return 0;
+
+    if (!(solbuf->t = (int64_t *)growarena(col, sizeof(int64_t)*nmax))) return 0;
+    for (i = 0;i < 3;i++) {
+        if (!(solbuf->pos[i] = (double *)growarena(col + 1 + i,
+                                                  sizeof(double)*nmax))) {
+            return 0;
+        }
+    }
+    if (!(solbuf->stat = (uint8_t *)growarena(col + 4, nmax))) return 0;
+    if (solbuf->ext) {
+        if (!(solbuf->ext = (solext_t *)growarena(col + 5,
+                                                  sizeof(solext_t)*nmax))) {
+            return 0;
+        }
+    }
+    solbuf->ngrow++;
+    solbuf->nmax = nmax;
+    return 1;
+}
+/* resize columns of solution buffer ----------------------------------------*/
+static int resizesolbuf(solbuf_t *solbuf, int nmax)
+{
+    void *p;
+    int i;
+
+    if (solbuf->arena) return resizearena(solbuf, nmax);
+
+    if (!(p = realloc(solbuf->t, sizeof(int64_t)*nmax))) return 0;
+    solbuf->t = (int64_t *)p;
+    for (i = 0;i < 3;i++) {
+        if (!(p = realloc(solbuf->pos[i], sizeof(double)*nmax))) return 0;
+        solbuf->pos[i] = (double *)p;
+    }
+    if (!(p = realloc(solbuf->stat, sizeof(uint8_t)*nmax))) return 0;
+    solbuf->stat = (uint8_t *)p;
+    if (solbuf->ext) {
+        if (!(p = realloc(solbuf->ext, sizeof(solext_t)*nmax))) return 0;
+        solbuf->ext = (solext_t *)p;
+    }
+    if (nmax > solbuf->nmax) solbuf->ngrow++;
+    solbuf->nmax = nmax;
+    return 1;
+}
+/* extra data of solution ----------------------------------------------------*/
+static int solext(const sol_t *sol, solext_t *ext)
+{
+    static const solext_t ext0 = { { 0 } };
+    int i;
+
+    memset(ext, 0, sizeof(solext_t));
+    for (i = 0;i < 3;i++) ext->rr[i] = sol->rr[i + 3];
+    for (i = 0;i < 6;i++) {
+        ext->qr[i] = sol->qr[i];
+        ext->qv[i] = sol->qv[i];
+        ext->dtr[i] = sol->dtr[i];
+    }
+    ext->type = sol->type == 1 ? 1 : 0;
+    ext->ns = sol->ns;
+    ext->age = sol->age;
+    ext->ratio = sol->ratio;
+    ext->thres = sol->thres;
+    return memcmp(ext, &ext0, sizeof(solext_t)) != 0;
+}
+/* set solution to columns of solution buffer --------------------------------*/
+static void setsol(solbuf_t *solbuf, int i, const sol_t *sol, const solext_t *ext)
+{
+    double pos[3];
+
+    solbuf->t[i] = time2tick(sol->time);
+    if (sol->type == 0) ecef2pos(sol->rr, pos);
+    else {
+        pos[0] = sol->rr[0];
+        pos[1] = sol->rr[1];
+        pos[2] = sol->rr[2];
+    }
+    solbuf->pos[0][i] = pos[0];
+    solbuf->pos[1][i] = pos[1];
+    solbuf->pos[2][i] = pos[2];
+    solbuf->stat[i] = sol->stat;
+    if (solbuf->ext) {
+        if (ext) solbuf->ext[i] = *ext;
+        else memset(solbuf->ext + i, 0, sizeof(solext_t));
+    }
+}
+/* sum positions of solution buffer --------------------------------------------
+* add positions of solutions solbuf[nsum...n-1] to sum for mean position. the
+* positions are transformed to ecef by blocks of SUMBLK solutions, so the sum
+* is done while the solutions just added are in cache (linear buffer only)
+*-----------------------------------------------------------------------------*/
+static void sumsolbuf(solbuf_t *solbuf)
+{
+    double x[SUMBLK], y[SUMBLK], z[SUMBLK], *r[3], *p[3];
+    int i, j, m;
+
+    r[0] = x; r[1] = y; r[2] = z;
+
+    for (i = solbuf->nsum;i < solbuf->n;i += m) {
+        m = solbuf->n - i < SUMBLK ? solbuf->n - i : SUMBLK;
+        for (j = 0;j < 3;j++) p[j] = solbuf->pos[j] + i;
+        pos2ecefv(p, r, m);
+        addpossum(&solbuf->psum, r, m);
+    }
+    solbuf->nsum = solbuf->n;
+}
 /* add solution data to solution buffer ----------------------------------------
 * add solution data to solution buffer
 * args   : solbuf_t *solbuf IO solution buffer
 *          sol_t  *sol      I  solution data
 * return : status (1:ok,0:error)
+* notes  : extra columns (solbuf->ext) are allocated by the first solution
+*          with velocity, covariance, clock or AR data
+*          ecef position (sol->type=0) is stored as geodetic position
+*          if solbuf->summ is set, the positions are summed for solmean() by
+*          blocks of SUMBLK solutions
 *-----------------------------------------------------------------------------*/
 extern int addsol(solbuf_t *solbuf, const sol_t *sol)
 {
-    sol_t *solbuf_data;
+    solext_t ext;
+    int isext = solext(sol, &ext);
 
-    if (solbuf->cyclic) { /* ring buffer */
+    if (solbuf->cyclic) {
         if (solbuf->nmax <= 1) return 0;
-        solbuf->data[solbuf->end] = *sol;
+    }
+    else if (solbuf->n >= solbuf->nmax) {
+        if (!resizesolbuf(solbuf, solbuf->nmax == 0 ? 8192 : solbuf->nmax * 2)) {
+            freesolbuf(solbuf);
+            return 0;
+        }
+    }
+    if (isext && !solbuf->ext && !allocext(solbuf)) return 0;
+    if (solbuf->cyclic) { /* ring buffer */
+        setsol(solbuf, solbuf->end, sol, isext ? &ext : NULL);
         if (++solbuf->end >= solbuf->nmax) solbuf->end = 0;
         if (solbuf->start == solbuf->end) {
             if (++solbuf->start >= solbuf->nmax) solbuf->start = 0;
@@ -243,18 +627,44 @@ extern int addsol(solbuf_t *solbuf, const sol_t *sol)
 
         return 1;
     }
-    if (solbuf->n >= solbuf->nmax) {
-        solbuf->nmax = solbuf->nmax == 0 ? 8192 : solbuf->nmax * 2;
-        if (!(solbuf_data = (sol_t *)realloc(solbuf->data, sizeof(sol_t)*solbuf->nmax))) {
-            free(solbuf->data); solbuf->data = NULL; solbuf->n = solbuf->nmax = 0;
-            return 0;
-        }
-        solbuf->data = solbuf_data;
-    }
-    solbuf->data[solbuf->n++] = *sol;
+    setsol(solbuf, solbuf->n++, sol, isext ? &ext : NULL);
+
+    if (solbuf->summ && solbuf->n - solbuf->nsum >= SUMBLK) sumsolbuf(solbuf);
     return 1;
 }
 
+/* input solution line --------------------------------------------------------
+* decode and screen one solution line
+* args   : char   *buff     I  line (not need to be terminated by '\0')
+*          int    n         I  length of line without "\n" (bytes)
+*          solfilt_t *filt  I  solution filter
+*          solbuf_t *solbuf IO solution buffer (current time, ref position)
+*          sol_t  *sol      O  solution
+* return : status (1:solution received,0:no solution,-1:disconnect received,
+*                  -2:invalid line,2:screened out by filter)
+* notes  : lines screened out by filter are not decoded after time field
+*-----------------------------------------------------------------------------*/
+static int inputsolline(const char *buff, int n, const solfilt_t *filt,
+    const solopt_t *opt, solbuf_t *solbuf, sol_t *sol)
+{
+    int stat, len = (int)strlen(MSG_DISCONN) - 2;
+
+    if (n > 0 && buff[n - 1] == '\r') n--;
+
+    /* check disconnect message */
+    if (n >= len && !strncmp(buff, MSG_DISCONN, len)) {
+      //  trace(3, "disconnect received\n");
+        return -1;
+    }
+    /* decode solution */
+    sol->time = solbuf->time;
+    if ((stat = decode_sol(buff, n, opt, filt, sol, solbuf->rb))>0) {
+        if (stat) solbuf->time = sol->time; /* update current time */
+        return stat;
+    }
+    if (stat < 0) return -2;
+    return 0;
+}
 /* input solution data from stream ---------------------------------------------
 * input solution data from stream
 * args   : uint8_t data     I stream data
@@ -263,86 +673,504 @@ extern int addsol(solbuf_t *solbuf, const sol_t *sol)
 *          double tint      I  time interval (0: all)
 *          int    qflag     I  quality flag  (0: all)
 *          solbuf_t *solbuf IO solution buffer
-* return : status (1:solution received,0:no solution,-1:disconnect received)
+* return : status (1:solution received,0:no solution,-1:disconnect received,
+*                  -2:invalid line)
+* notes  : for byte stream sources. solution files are read by readsoldata()
+*          the filter is compiled once and kept in solbuf until ts, te, tint
+*          or qflag is changed
 *-----------------------------------------------------------------------------*/
 extern int inputsol(uint8_t data, gtime_t ts, gtime_t te, double tint,
     int qflag, const solopt_t *opt, solbuf_t *solbuf)
 {
     sol_t sol = { { 0 } };
-    int stat;
-
-    sol.time = solbuf->time;
+    int n, stat;
 
     if (data == '$' || (!isprint(data) && data != '\r'&&data != '\n')) { /* sync header */
         solbuf->nb = 0;
     }
     if (data != '\r'&&data != '\n') {
         solbuf->buff[solbuf->nb++] = data;
-        printf("%c\n",data);
     }
     if (data != '\n'&&solbuf->nb<MAXSOLMSG) return 0; /* sync trailer */
 
-    solbuf->buff[solbuf->nb] = '\0';
+    n = solbuf->nb;
     solbuf->nb = 0;
 
-    /* check disconnect message */
-    if (!strncmp((char *)solbuf->buff, MSG_DISCONN, strlen(MSG_DISCONN) - 2)) {
-      //  trace(3, "disconnect received\n");
-        return -1;
-    }
-    /* decode solution */
-    sol.time = solbuf->time;
-    if ((stat = decode_sol((char *)solbuf->buff, opt, &sol, solbuf->rb))>0) {
-        if (stat) solbuf->time = sol.time; /* update current time */
-        if (stat != 1) return 0;
+    if (!samefilt(&solbuf->filt, ts, te, tint, qflag)) {
+        initfilt(&solbuf->filt, ts, te, tint, qflag);
     }
-    if (stat != 1 || !screent(sol.time, ts, te, tint) || (qflag&&sol.stat != qflag)) {
-        return 0;
+    if ((stat = inputsolline((const char *)solbuf->buff, n, &solbuf->filt, opt,
+                             solbuf, &sol)) != 1) {
+        return stat == 2 ? 0 : stat;
     }
     /* add solution to solution buffer */
     return addsol(solbuf, &sol);
 }
-/* read solution data --------------------------------------------------------*/
-static int readsoldata(FILE *fp, gtime_t ts, gtime_t te, double tint, int qflag,
-    const solopt_t *opt, solbuf_t *solbuf)
+/* input solution record -------------------------------------------------------
+* input a line of solution file and pass the solution to callback function
+* of the reader (if set) or add it to solution buffer
+*-----------------------------------------------------------------------------*/
+static void inputsolrec(const char *buff, int n, const solfilt_t *filt,
+    const solopt_t *opt, rdstat_t *rs, solbuf_t *solbuf)
+{
+    sol_t sol = { { 0 } };
+    int stat;
+
+    rs->line++;
+    stat = inputsolline(buff, n, filt, opt, solbuf, &sol);
+
+    if (stat == -2) {
+        if (!rs->nerr++) rs->lerr = rs->line;
+    }
+    else if (stat == 2) rs->nscr++;
+    else if (stat == 1) {
+        rs->nsol++;
+        if (!rs->func) {
+            if (!addsol(solbuf, &sol)) rs->merr = rs->stop = 1;
+        }
+        else if (!rs->func(&sol, rs->arg)) rs->stop = 1;
+    }
+}
+/* input solution lines ---------------------------------------------------------
+* input complete lines in memory block. line boundaries are found by memchr()
+* and whole lines are passed to inputsolline(). lines longer than MAXSOLMSG
+* are truncated. the scanner runs at >1 GB/s, so reading is bound by
+* decode_sol() (target: 100 MB/s for typical .pos files).
+* args   : const char *buff I  memory block
+*          const char *end  I  end of memory block
+*          int    eof       I  block ends at end of file (1:input last line)
+*          ...
+*          rdstat_t *rs     IO line reader status
+* return : pointer to the remaining partial line
+*-----------------------------------------------------------------------------*/
+static const char *inputsolblk(const char *buff, const char *end, int eof,
+    const solfilt_t *filt, const solopt_t *opt, rdstat_t *rs, solbuf_t *solbuf)
+{
+    const char *p, *q;
+
+    for (p = buff;!rs->stop && (q = (const char *)memchr(p, '\n', end - p));
+         p = q + 1) {
+        if (rs->skip) { rs->skip = 0; continue; }
+        inputsolrec(p, (int)(q - p), filt, opt, rs, solbuf);
+    }
+    if (rs->stop || rs->skip) return end;
+
+    if (end - p >= MAXSOLMSG || (eof && end > p)) { /* too long or last line */
+        inputsolrec(p, (int)(end - p < MAXSOLMSG ? end - p : MAXSOLMSG), filt,
+                    opt, rs, solbuf);
+        rs->skip = !eof;
+        return end;
+    }
+    return p;
+}
+/* read solution data ----------------------------------------------------------
+* read solution data from file by blocks of MAXSOLBLK bytes. the partial line
+* at the end of block is moved to the head of buffer and completed by the
+* next block. used for pipes and if memory mapping is disabled or fails
+* args   : FILE   *fp       I  file pointer
+*          int64_t size     I  max size to read (bytes)
+*                              (-1: to end of file including last partial line)
+*          ...
+*          solrdbuf_t *rdbuf IO buffers of reader (NULL: allocated)
+* return : size of lines read (bytes)
+* notes  : with size>=0, only complete lines terminated by "\n" are read as
+*          readsolmap() for a range of file, and the partial line at the end
+*          is left to the next read
+*-----------------------------------------------------------------------------*/
+static int64_t readsoldata(FILE *fp, int64_t size, const solfilt_t *filt,
+    const solopt_t *opt, rdstat_t *rs, solrdbuf_t *rdbuf, solbuf_t *solbuf)
+{
+    char *buff;
+    const char *p, *q, *e;
+    size_t nb = 0, nr, nrd;
+    int64_t off = 0;
+
+    if (rdbuf && !rdbuf->buff) rdbuf->buff = (char *)malloc(MAXSOLBLK);
+
+    if (!(buff = rdbuf ? rdbuf->buff : (char *)malloc(MAXSOLBLK))) {
+       // trace(1, "readsoldata: memory allocation error\n");
+        rs->merr = 1;
+        return 0;
+    }
+    for (;!rs->stop;off += nr) {
+        nrd = MAXSOLBLK - nb;
+        if (size >= 0 && size - off < (int64_t)nrd) nrd = (size_t)(size - off);
+        if ((nr = fread(buff + nb, 1, nrd, fp)) <= 0) break;
+        e = buff + nb + nr;
+        if (size >= 0) { /* complete lines (partial line over block is input) */
+            for (q = e;q > buff && q[-1] != '\n';q--) ;
+            if (q > buff || nb + nr < MAXSOLBLK) e = q;
+        }
+        p = inputsolblk(buff, e, 0, filt, opt, rs, solbuf);
+        nb = buff + nb + nr - p;
+        memmove(buff, p, nb);
+    }
+    if (size < 0) inputsolblk(buff, buff + nb, 1, filt, opt, rs, solbuf);
+    else off -= (int64_t)nb;
+    if (!rdbuf) free(buff);
+    return off;
+}
+/* append solution buffer ---------------------------------------------------*/
+static int appendsolbuf(solbuf_t *solbuf, const solbuf_t *src)
 {
-    int c;
+    int i, n = solbuf->n;
+
+    if (src->n <= 0) return 1;
+
+    if (solbuf->summ) sumsolbuf(solbuf);
+
+    if (n + src->n > solbuf->nmax && !resizesolbuf(solbuf, n + src->n)) {
+        return 0;
+    }
+    if (src->ext && !solbuf->ext && !allocext(solbuf)) return 0;
+    memcpy(solbuf->t + n, src->t, sizeof(int64_t)*src->n);
+    for (i = 0;i < 3;i++) {
+        memcpy(solbuf->pos[i] + n, src->pos[i], sizeof(double)*src->n);
+    }
+    memcpy(solbuf->stat + n, src->stat, sizeof(uint8_t)*src->n);
+    if (src->ext) {
+        memcpy(solbuf->ext + n, src->ext, sizeof(solext_t)*src->n);
+    }
+    else if (solbuf->ext) {
+        memset(solbuf->ext + n, 0, sizeof(solext_t)*src->n);
+    }
+    solbuf->n += src->n;
 
-    while ((c = fgetc(fp)) != EOF) {
-        /* input solution */
-        inputsol((uint8_t)c, ts, te, tint, qflag, opt, solbuf);
+    if (solbuf->summ && src->summ && src->nsum == src->n) { /* merge sums */
+        mergepossum(&solbuf->psum, &src->psum);
+        solbuf->nsum = solbuf->n;
     }
-    return solbuf->n>0;
+    return 1;
 }
-/* compare solution data -----------------------------------------------------*/
+/* parse thread ----------------------------------------------------------------
+* decode a range of lines of mapped file into private solution buffer
+*-----------------------------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI rdthread(void *arg)
+#else
+static void *rdthread(void *arg)
+#endif
+{
+    rdjob_t *job = (rdjob_t *)arg;
+
+    inputsolblk(job->buff, job->end, 1, job->filt, job->opt, &job->rs,
+                &job->solbuf);
+    if (job->solbuf.summ) sumsolbuf(&job->solbuf);
+    return 0;
+}
+/* parse jobs of reader ------------------------------------------------------*/
+static rdjob_t *getjobs(solrdbuf_t *rdbuf, int n)
+{
+    rdjob_t *job;
+    int i;
+
+    if (!rdbuf) {
+        if (!(job = (rdjob_t *)malloc(sizeof(rdjob_t)*n))) return NULL;
+        for (i = 0;i < n;i++) initsolbuf(&job[i].solbuf, 0, 0);
+        return job;
+    }
+    if (rdbuf->njob < n) {
+        if (!(job = (rdjob_t *)realloc(rdbuf->job, sizeof(rdjob_t)*n))) return NULL;
+        for (i = rdbuf->njob;i < n;i++) initsolbuf(&job[i].solbuf, 0, 0);
+        rdbuf->job = job;
+        rdbuf->njob = n;
+    }
+    return (rdjob_t *)rdbuf->job;
+}
+/* read solution data from memory mapped file ----------------------------------
+* lines are decoded directly from the mapped pages without copy. with
+* nthread>1, the file is split into ranges at line boundaries (at least
+* MINRDRANGE bytes each), each range is decoded by own thread into private
+* buffer and the buffers are concatenated in order of the ranges, so the
+* contents of solution buffer is same as single thread. the jobs are
+* allocated on heap, since the reader runs on worker threads of small stack,
+* and kept in rdbuf (if not NULL) with the private buffers for next file
+* return : status (1:ok,0:memory allocation error (rs->merr set))
+*-----------------------------------------------------------------------------*/
+static int readsolmap(const mapfile_t *map, const solfilt_t *filt,
+    const solopt_t *opt, int nthread, rdstat_t *rs, solrdbuf_t *rdbuf,
+    solbuf_t *solbuf)
+{
+    rdjob_t *job;
+    thread_t thread[MAXRDTHREAD];
+    const char *p = map->data, *end = map->data + map->size, *q;
+    size_t size;
+    int i, n;
+
+    if (nthread > MAXRDTHREAD) nthread = MAXRDTHREAD;
+    if (nthread > (int)(map->size / MINRDRANGE)) nthread = (int)(map->size / MINRDRANGE);
+
+    if (nthread <= 1 || !(job = getjobs(rdbuf, nthread))) {
+        inputsolblk(p, end, 1, filt, opt, rs, solbuf);
+        return !rs->merr;
+    }
+    /* split at line boundaries */
+    size = map->size / nthread;
+    for (n = 0;n < nthread && p < end;n++, p = q) {
+        if (n == nthread - 1 || (size_t)(end - p) <= size) q = end;
+        else if (!(q = (const char *)memchr(p + size, '\n', end - p - size))) q = end;
+        else q++;
+        memset(&job[n].rs, 0, sizeof(rdstat_t));
+        job[n].buff = p; job[n].end = q;
+        job[n].filt = filt;
+        job[n].opt = opt;
+        clearsolbuf(&job[n].solbuf);
+        job[n].solbuf.summ = solbuf->summ;
+    }
+    for (i = 0;i < n;i++) {
+#ifdef WIN32
+        if (!(thread[i] = CreateThread(NULL, 0, rdthread, job + i, 0, NULL))) {
+#else
+        if (pthread_create(thread + i, NULL, rdthread, job + i)) {
+#endif
+            rdthread(job + i); /* decode in this thread if creation failed */
+            job[i].thread = 0;
+        }
+        else job[i].thread = 1;
+    }
+    for (i = 0;i < n;i++) {
+        if (job[i].thread) {
+#ifdef WIN32
+            WaitForSingleObject(thread[i], INFINITE);
+            CloseHandle(thread[i]);
+#else
+            pthread_join(thread[i], NULL);
+#endif
+        }
+        if (job[i].rs.nerr > 0 && !rs->nerr) rs->lerr = rs->line + job[i].rs.lerr;
+        rs->nerr += job[i].rs.nerr;
+        rs->line += job[i].rs.line;
+        rs->nsol += job[i].rs.nsol;
+        rs->nscr += job[i].rs.nscr;
+        solbuf->ngrow += job[i].solbuf.ngrow;
+
+        if (job[i].rs.merr || (!rs->merr && !appendsolbuf(solbuf, &job[i].solbuf))) {
+            rs->merr = 1;
+        }
+        if (rdbuf) clearsolbuf(&job[i].solbuf);
+        else freesolbuf(&job[i].solbuf);
+    }
+    if (!rdbuf) free(job);
+    return !rs->merr;
+}
+/* compare solution time and index -----------------------------------------*/
 static int cmpsol(const void *p1, const void *p2)
 {
-    sol_t *q1 = (sol_t *)p1, *q2 = (sol_t *)p2;
-    double tt = timediff(q1->time, q2->time);
-    return tt<-0.0 ? -1 : (tt>0.0 ? 1 : 0);
+    const solkey_t *q1 = (const solkey_t *)p1, *q2 = (const solkey_t *)p2;
+    return q1->t < q2->t ? -1 : (q1->t > q2->t ? 1 : q1->i - q2->i);
+}
+/* find sorted runs ------------------------------------------------------------
+* find ascending runs of time t[idx[s]]...t[idx[e-1]]
+* return : number of runs (run[0..nrun] are start indexes and end of last run)
+*          (nmax+1: more than nmax runs)
+*-----------------------------------------------------------------------------*/
+static int findruns(const int64_t *t, const int *idx, int s, int e, int *run,
+                    int nmax)
+{
+    int i, n = 0;
+
+    run[n++] = s;
+    for (i = s + 1;i < e;i++) {
+        if (t[idx[i]] >= t[idx[i - 1]]) continue;
+        if (n >= nmax) return nmax + 1;
+        run[n++] = i;
+    }
+    run[n] = e;
+    return n;
 }
-/* sort solution data --------------------------------------------------------*/
-static int sort_solbuf(solbuf_t *solbuf)
+/* merge sorted runs -----------------------------------------------------------
+* k-way merge of ascending runs idx[run[i]]...idx[run[i+1]-1] (i=0..nrun-1)
+* by binary heap of run heads. solutions of same time keep the order of runs
+*-----------------------------------------------------------------------------*/
+static void mergeruns(const int64_t *t, const int *idx, const int *run,
+                      int nrun, int *out)
 {
-    sol_t *solbuf_data;
+    int i, j, k = 0, c, n = 0, h[MAXSORTRUN], pos[MAXSORTRUN];
+
+#define HEAPLT(a,b) (t[idx[pos[a]]] < t[idx[pos[b]]] || \
+                     (t[idx[pos[a]]] == t[idx[pos[b]]] && (a) < (b)))
+
+    for (i = 0;i < nrun;i++) {
+        if ((pos[i] = run[i]) >= run[i + 1]) continue;
+        for (j = k++, h[j] = i;j > 0 && HEAPLT(h[j], h[(j - 1) / 2]);j = (j - 1) / 2) {
+            c = h[j]; h[j] = h[(j - 1) / 2]; h[(j - 1) / 2] = c;
+        }
+    }
+    while (k > 0) {
+        i = h[0];
+        out[n++] = idx[pos[i]++];
+        if (pos[i] >= run[i + 1]) h[0] = h[--k]; /* end of run */
+
+        for (j = 0;(c = 2 * j + 1) < k;j = c) { /* sift down */
+            if (c + 1 < k && HEAPLT(h[c + 1], h[c])) c++;
+            if (!HEAPLT(h[c], h[j])) break;
+            i = h[j]; h[j] = h[c]; h[c] = i;
+        }
+    }
+#undef HEAPLT
+}
+/* sort index of solutions -----------------------------------------------------
+* sort idx[s]...idx[e-1] by time. already sorted range is left as is, nearly
+* sorted range (<=MAXSORTRUN runs) is merged from the runs and others are
+* sorted by qsort() of time/index keys
+* return : status (1:ok,0:memory allocation error)
+*-----------------------------------------------------------------------------*/
+static int sortidx(const int64_t *t, int *idx, int s, int e)
+{
+    solkey_t *key;
+    int i, n, run[MAXSORTRUN + 1], *out;
+
+    if ((n = findruns(t, idx, s, e, run, MAXSORTRUN)) <= 1) return 1;
+
+    if (n <= MAXSORTRUN) {
+        if (!(out = (int *)malloc(sizeof(int)*(e - s)))) return 0;
+        mergeruns(t, idx, run, n, out);
+        memcpy(idx + s, out, sizeof(int)*(e - s));
+        free(out);
+        return 1;
+    }
+    if (!(key = (solkey_t *)malloc(sizeof(solkey_t)*(e - s)))) return 0;
+    for (i = s;i < e;i++) {
+        key[i - s].t = t[idx[i]];
+        key[i - s].i = idx[i];
+    }
+    qsort(key, e - s, sizeof(solkey_t), cmpsol);
+    for (i = s;i < e;i++) idx[i] = key[i - s].i;
+    free(key);
+    return 1;
+}
+/* permute columns -----------------------------------------------------------*/
+static int permcol(void **col, size_t size, const int *idx, int n, int inplace)
+{
+    char *p, *q = (char *)*col;
+    int i;
+
+    if (!q) return 1;
+    if (!(p = (char *)malloc(size*n))) return 0;
+    for (i = 0;i < n;i++) memcpy(p + size*i, q + size*idx[i], size);
+    if (inplace) { /* column in arena */
+        memcpy(q, p, size*n);
+        free(p);
+        return 1;
+    }
+    free(q);
+    *col = p;
+    return 1;
+}
+/* sort solution data ----------------------------------------------------------
+* sort solution data by time
+* args   : solbuf_t *solbuf IO solution buffer
+*          int    *seg      I  start index of data of each file (NULL: one file)
+*          int    nseg      I  number of files
+* return : status (1:ok,0:no data or error)
+* notes  : solutions of each file are sorted by sortidx() and then those of
+*          files are merged by k-way merge. the order is found on the time
+*          column and the other columns are permuted once at the end
+*-----------------------------------------------------------------------------*/
+static int sort_solbuf(solbuf_t *solbuf, const int *seg, int nseg)
+{
+    int i, n = solbuf->n, stat = 1, run[2], *idx, *out, a;
 
     //trace(4, "sort_solbuf: n=%d\n", solbuf->n);
 
-    if (solbuf->n <= 0) return 0;
+    if (n <= 0) return 0;
 
-    if (!(solbuf_data = (sol_t *)realloc(solbuf->data, sizeof(sol_t)*solbuf->n))) {
+    if (!resizesolbuf(solbuf, n) || !(idx = (int *)malloc(sizeof(int)*n))) {
        // trace(1, "sort_solbuf: memory allocation error\n");
-        free(solbuf->data); solbuf->data = NULL; solbuf->n = solbuf->nmax = 0;
+        freesolbuf(solbuf);
         return 0;
     }
-    solbuf->data = solbuf_data;
-    qsort(solbuf->data, solbuf->n, sizeof(sol_t), cmpsol);
-    solbuf->nmax = solbuf->n;
     solbuf->start = 0;
-    solbuf->end = solbuf->n - 1;
+    solbuf->end = n - 1;
+
+    for (i = 0;i < n;i++) idx[i] = i;
+
+    if (!seg || nseg <= 1 || nseg > MAXSORTRUN) {
+        stat = sortidx(solbuf->t, idx, 0, n);
+    }
+    else {
+        for (i = 0;i < nseg && stat;i++) {
+            stat = sortidx(solbuf->t, idx, seg[i], seg[i + 1]);
+        }
+        if (stat && findruns(solbuf->t, idx, 0, n, run, 1) > 1) {
+            if (!(out = (int *)malloc(sizeof(int)*n))) stat = 0;
+            else {
+                mergeruns(solbuf->t, idx, seg, nseg, out);
+                free(idx);
+                idx = out;
+            }
+        }
+    }
+    for (i = 0;i < n && stat;i++) {
+        if (idx[i] != i) break;
+    }
+    if (stat && i < n) { /* permute columns */
+        a = solbuf->arena != NULL;
+        stat = permcol((void **)&solbuf->t, sizeof(int64_t), idx, n, a) &&
+               permcol((void **)&solbuf->pos[0], sizeof(double), idx, n, a) &&
+               permcol((void **)&solbuf->pos[1], sizeof(double), idx, n, a) &&
+               permcol((void **)&solbuf->pos[2], sizeof(double), idx, n, a) &&
+               permcol((void **)&solbuf->stat, sizeof(uint8_t), idx, n, a) &&
+               permcol((void **)&solbuf->ext, sizeof(solext_t), idx, n, a);
+    }
+    free(idx);
+    if (!stat) freesolbuf(solbuf);
+    return stat;
+}
+
+/* copy solution buffer --------------------------------------------------------
+* copy solutions of solution buffer in order of time to linear buffer
+* args   : solbuf_t *dst    IO solution buffer (linear)
+*          solbuf_t *src    I  solution buffer (linear or cyclic)
+* return : status (1:ok,0:memory allocation error)
+* notes  : the columns of dst are reused and only grown. the solutions of
+*          cyclic buffer are copied from start to end by two blocks
+*-----------------------------------------------------------------------------*/
+extern int copysolbuf(solbuf_t *dst, const solbuf_t *src)
+{
+    int i, k, m, n = src->n, s = src->cyclic ? src->start : 0;
+
+    if (n > dst->nmax && !resizesolbuf(dst, n)) return 0;
+    if (src->ext && !dst->ext && !allocext(dst)) return 0;
+    for (k = 0;k < n;k += m, s = 0) {
+        m = s + n - k <= src->nmax ? n - k : src->nmax - s;
+        memcpy(dst->t + k, src->t + s, sizeof(int64_t)*m);
+        for (i = 0;i < 3;i++) {
+            memcpy(dst->pos[i] + k, src->pos[i] + s, sizeof(double)*m);
+        }
+        memcpy(dst->stat + k, src->stat + s, sizeof(uint8_t)*m);
+        if (src->ext) memcpy(dst->ext + k, src->ext + s, sizeof(solext_t)*m);
+        else if (dst->ext) memset(dst->ext + k, 0, sizeof(solext_t)*m);
+    }
+    dst->n = n;
+    dst->start = 0;
+    dst->end = n > 0 ? n - 1 : 0;
+    dst->nsum = 0;
+    memset(&dst->psum, 0, sizeof(possum_t));
+    dst->time = src->time;
+    for (i = 0;i < 3;i++) dst->rb[i] = src->rb[i];
     return 1;
 }
+/* mean position of solution buffer --------------------------------------------
+* mean ecef position of solutions in solution buffer
+* args   : solbuf_t *solbuf IO solution buffer (linear)
+*          double *rr       O  mean ecef position {x,y,z} (m)
+* return : status (1:ok,0:no solution or cyclic buffer)
+* notes  : if solbuf->summ is set, the sum of positions while added is
+*          completed by the rest. otherwise all positions are summed. the sum
+*          is compensated, see addpossum()
+*-----------------------------------------------------------------------------*/
+extern int solmean(solbuf_t *solbuf, double *rr)
+{
+    if (solbuf->cyclic || solbuf->n <= 0) return 0;
 
+    if (!solbuf->summ) {
+        solbuf->nsum = 0;
+        memset(&solbuf->psum, 0, sizeof(possum_t));
+    }
+    sumsolbuf(solbuf);
+    return meanpossum(&solbuf->psum, rr);
+}
 /* initialize solution buffer --------------------------------------------------
 * initialize position solutions
 * args   : solbuf_t *solbuf I  solution buffer
@@ -364,17 +1192,25 @@ extern void initsolbuf(solbuf_t *solbuf, int cyclic, int nmax)
 #if 0
     solbuf->time = time0;
 #endif
-    solbuf->data = NULL;
+    solbuf->t = NULL;
+    solbuf->pos[0] = solbuf->pos[1] = solbuf->pos[2] = NULL;
+    solbuf->stat = NULL;
+    solbuf->ext = NULL;
+    solbuf->arena = NULL;
+    solbuf->ngrow = 0;
+    solbuf->summ = solbuf->nsum = 0;
+    memset(&solbuf->psum, 0, sizeof(possum_t));
+    solbuf->filt.valid = 0;
     for (i = 0;i<3;i++) {
         solbuf->rb[i] = 0.0;
     }
     if (cyclic) {
         if (nmax <= 2) nmax = 2;
-        if (!(solbuf->data =(sol_t*) malloc(sizeof(sol_t)*nmax))) {
+        if (!resizesolbuf(solbuf, nmax)) {
            // trace(1, "initsolbuf: memory allocation error\n");
+            freesolbuf(solbuf);
             return;
         }
-        solbuf->nmax = nmax;
     }
 }
 
@@ -387,14 +1223,548 @@ extern void initsolbuf(solbuf_t *solbuf, int cyclic, int nmax)
 extern void freesolbuf(solbuf_t *solbuf)
 {
     int i;
-    free(solbuf->data);
+    if (solbuf->arena) { /* release arena for reuse */
+        for (i = 0;i < 6;i++) trimarena(solbuf->arena->col + i, ARENAKEEP);
+        solbuf->arena->inuse = 0;
+        solbuf->arena = NULL;
+    }
+    else {
+        free(solbuf->t);
+        for (i = 0;i<3;i++) free(solbuf->pos[i]);
+        free(solbuf->stat);
+        free(solbuf->ext);
+    }
     solbuf->n = solbuf->nmax = solbuf->start = solbuf->end = solbuf->nb = 0;
-    solbuf->data = NULL;
+    solbuf->ngrow = 0;
+    solbuf->summ = solbuf->nsum = 0;
+    memset(&solbuf->psum, 0, sizeof(possum_t));
+    solbuf->t = NULL;
+    solbuf->pos[0] = solbuf->pos[1] = solbuf->pos[2] = NULL;
+    solbuf->stat = NULL;
+    solbuf->ext = NULL;
     for (i = 0;i<3;i++) {
         solbuf->rb[i] = 0.0;
     }
 }
+/* clear solution buffer -------------------------------------------------------
+* clear solutions of solution buffer to reuse the columns
+* args   : solbuf_t *solbuf IO solution buffer
+* return : none
+* notes  : the number of solutions is reset and the columns are kept, so the
+*          next solutions are added without allocation. as the arena kept
+*          after use, the columns over ARENAKEEP bytes in total are shrunk and
+*          the extra data column is freed. the columns in arena are released
+*          by freesolbuf()
+*-----------------------------------------------------------------------------*/
+extern void clearsolbuf(solbuf_t *solbuf)
+{
+    int i, nkeep = ARENAKEEP / (int)(sizeof(int64_t) + sizeof(double) * 3 + 1);
+
+    if (solbuf->arena) {
+        freesolbuf(solbuf);
+        return;
+    }
+    free(solbuf->ext);
+    solbuf->ext = NULL;
+    if (solbuf->nmax > nkeep && !solbuf->cyclic && !resizesolbuf(solbuf, nkeep)) {
+        freesolbuf(solbuf);
+    }
+    solbuf->n = solbuf->start = solbuf->end = solbuf->nb = 0;
+    solbuf->ngrow = 0;
+    solbuf->summ = solbuf->nsum = 0;
+    memset(&solbuf->psum, 0, sizeof(possum_t));
+    solbuf->filt.valid = 0;
+    for (i = 0;i < 3;i++) {
+        solbuf->rb[i] = 0.0;
+    }
+}
+/* memory of solution buffer ---------------------------------------------------
+* memory of columns of solution buffer (bytes)
+*-----------------------------------------------------------------------------*/
+extern size_t solbufmem(const solbuf_t *solbuf)
+{
+    return (size_t)solbuf->nmax * (sizeof(int64_t) + sizeof(double) * 3 + 1 +
+                                   (solbuf->ext ? sizeof(solext_t) : 0));
+}
+/* initialize buffers of reader ------------------------------------------------
+* initialize reusable buffers of solution reader (rdopt_t.rdbuf)
+* args   : solrdbuf_t *rdbuf O buffers of reader
+* return : none
+* notes  : the buffers are allocated by the first read and kept until
+*          freerdbuf()
+*-----------------------------------------------------------------------------*/
+extern void initrdbuf(solrdbuf_t *rdbuf)
+{
+    rdbuf->buff = NULL;
+    rdbuf->job = NULL;
+    rdbuf->njob = 0;
+}
+/* free buffers of reader ----------------------------------------------------*/
+extern void freerdbuf(solrdbuf_t *rdbuf)
+{
+    rdjob_t *job = (rdjob_t *)rdbuf->job;
+    int i;
+
+    for (i = 0;i < rdbuf->njob;i++) freesolbuf(&job[i].solbuf);
+    free(rdbuf->job);
+    free(rdbuf->buff);
+    initrdbuf(rdbuf);
+}
+/* memory of buffers of reader (bytes) ---------------------------------------*/
+extern size_t rdbufmem(const solrdbuf_t *rdbuf)
+{
+    const rdjob_t *job = (const rdjob_t *)rdbuf->job;
+    size_t size = rdbuf->buff ? MAXSOLBLK : 0;
+    int i;
+
+    for (i = 0;i < rdbuf->njob;i++) {
+        size += sizeof(rdjob_t) + solbufmem(&job[i].solbuf);
+    }
+    return size;
+}
+
+/* hash of source file ---------------------------------------------------------
+* 64-bit FNV-1a hash of size and first/last CACHEHASH bytes of the first size
+* bytes of source file
+* args   : FILE   *fp       I  source file
+*          uint64_t size    I  size of source hashed (bytes)
+*          uint64_t *hash   O  hash
+* return : status (1:ok,0:error or file shorter than size)
+* notes  : with size and modification time, it detects rewritten or appended
+*          files without reading the whole file. with size shorter than the
+*          file, it detects a rewritten prefix of file (rotated logs)
+*-----------------------------------------------------------------------------*/
+extern int srchash(FILE *fp, uint64_t size, uint64_t *hash)
+{
+    uint8_t buff[CACHEHASH];
+    uint64_t h = 14695981039346656037ULL, off[2], len[2];
+    size_t i, n;
+    int k;
+
+    for (i = 0;i < 8;i++) {
+        h = (h ^ (uint8_t)(size >> (i * 8))) * 1099511628211ULL;
+    }
+    off[0] = 0;
+    len[0] = size < CACHEHASH ? size : CACHEHASH;
+    off[1] = size < 2 * CACHEHASH ? len[0] : size - CACHEHASH;
+    len[1] = size - off[1];
+
+    for (k = 0;k < 2;k++) {
+        if (len[k] == 0) continue;
+        if (fseekoff(fp, (int64_t)off[k], SEEK_SET)) return 0;
+        if ((n = fread(buff, 1, (size_t)len[k], fp)) < len[k]) return 0;
+        for (i = 0;i < n;i++) h = (h ^ buff[i]) * 1099511628211ULL;
+    }
+    *hash = h;
+    return 1;
+}
+/* source file information of solution cache ---------------------------------*/
+static int srcinfo(const char *file, solcache_t *hd)
+{
+    struct stat st;
+    FILE *fp;
+    int ret;
+
+    memset(hd, 0, sizeof(solcache_t));
+    if (stat(file, &st) || !S_ISREG(st.st_mode)) return 0;
+    if (!(fp = fopen(file, "rb"))) return 0;
+
+    memcpy(hd->id, CACHEID, 8);
+    hd->ver = CACHEVER;
+    hd->bom = 0x01020304;
+    hd->size = (uint64_t)st.st_size;
+    hd->mtime = (int64_t)st.st_mtime;
+    ret = srchash(fp, hd->size, &hd->hash);
+    fclose(fp);
+    return ret;
+}
+/* read solution cache ---------------------------------------------------------
+* read solutions from binary columnar cache <file>.solc of solution file
+* args   : char   *file     I  solution file
+*          solcache_t *src  I  header of source file by srcinfo()
+*          solfilt_t *filt  I  solution filter
+*          rdstat_t *rs     IO line reader status
+*          solbuf_t *solbuf IO solution buffer
+* return : status (1:read,0:no valid cache)
+* notes  : the cache is memory mapped and the columns are screened by filter
+*          without decoding. the cache is valid if the source file has same
+*          size, modification time and hash as recorded in the header
+*-----------------------------------------------------------------------------*/
+static int readcache(const char *file, const solcache_t *src,
+    const solfilt_t *filt, rdstat_t *rs, solbuf_t *solbuf)
+{
+    mapfile_t map;
+    solcache_t hd;
+    sol_t sol = { { 0 } };
+    const int64_t *t;
+    const double *pos[3];
+    const uint8_t *stat;
+    char path[1024];
+    int64_t i, n;
+
+    sprintf(path, "%.1018s%s", file, CACHEEXT);
+    if (!openmap(path, &map)) return 0;
+
+    if (map.size < sizeof(solcache_t)) {
+        closemap(&map);
+        return 0;
+    }
+    memcpy(&hd, map.data, sizeof(solcache_t));
+    n = hd.n;
+    if (memcmp(hd.id, src->id, 8) || hd.ver != src->ver || hd.bom != src->bom ||
+        hd.size != src->size || hd.mtime != src->mtime || hd.hash != src->hash ||
+        n < 0 || n > INT32_MAX ||
+        map.size != sizeof(solcache_t) + (uint64_t)n * 33) {
+        closemap(&map);
+        return 0;
+    }
+    t = (const int64_t *)(map.data + sizeof(solcache_t));
+    pos[0] = (const double *)(t + n);
+    pos[1] = pos[0] + n;
+    pos[2] = pos[1] + n;
+    stat = (const uint8_t *)(pos[2] + n);
+
+    for (i = 0;i < n && !rs->stop;i++) {
+        if (!testfilt(filt, t[i], stat[i])) {
+            rs->nscr++;
+            continue;
+        }
+        rs->nsol++;
+
+        if (rs->func) {
+            sol.time = tick2time(t[i]);
+            sol.rr[0] = pos[0][i]; sol.rr[1] = pos[1][i]; sol.rr[2] = pos[2][i];
+            sol.type = 2;
+            sol.stat = stat[i];
+            if (!rs->func(&sol, rs->arg)) rs->stop = 1;
+            continue;
+        }
+        if (solbuf->n >= solbuf->nmax &&
+            !resizesolbuf(solbuf, solbuf->nmax == 0 ? 8192 : solbuf->nmax * 2)) {
+            freesolbuf(solbuf);
+            break;
+        }
+        solbuf->t[solbuf->n] = t[i];
+        solbuf->pos[0][solbuf->n] = pos[0][i];
+        solbuf->pos[1][solbuf->n] = pos[1][i];
+        solbuf->pos[2][solbuf->n] = pos[2][i];
+        solbuf->stat[solbuf->n] = stat[i];
+        if (solbuf->ext) memset(solbuf->ext + solbuf->n, 0, sizeof(solext_t));
+        solbuf->n++;
+    }
+    rs->line = hd.line;
+    rs->nerr = hd.nerr;
+    rs->lerr = hd.lerr;
+    rs->byte += map.size;
+    closemap(&map);
+    return 1;
+}
+/* write solution cache --------------------------------------------------------
+* write solutions solbuf[n0...] parsed from solution file to cache <file>.solc
+* args   : char   *file     I  solution file
+*          solcache_t *src  I  header of source file by srcinfo()
+*          solbuf_t *solbuf I  solution buffer (all solutions of file)
+*          int    n0        I  index of first solution of file
+*          rdstat_t *rs     I  line reader status
+* return : none
+* notes  : the header is written last, so an incomplete cache is not valid.
+*          solutions with extra data are not cached
+*-----------------------------------------------------------------------------*/
+static void writecache(const char *file, const solcache_t *src,
+    const solbuf_t *solbuf, int n0, const rdstat_t *rs)
+{
+    solcache_t hd = *src;
+    FILE *fp;
+    char path[1024];
+    size_t n = (size_t)(solbuf->n - n0);
+    int i, stat;
+
+    if (solbuf->ext || n <= 0) return;
+
+    sprintf(path, "%.1018s%s", file, CACHEEXT);
+    if (!(fp = fopen(path, "wb"))) return;
+
+    hd.n = (int64_t)n;
+    hd.line = rs->line;
+    hd.nerr = rs->nerr;
+    hd.lerr = rs->lerr;
+    memset(hd.id, 0, 8);
+    stat = fwrite(&hd, sizeof(hd), 1, fp) == 1 &&
+           fwrite(solbuf->t + n0, sizeof(int64_t), n, fp) == n;
+    for (i = 0;i < 3 && stat;i++) {
+        stat = fwrite(solbuf->pos[i] + n0, sizeof(double), n, fp) == n;
+    }
+    stat = stat && fwrite(solbuf->stat + n0, sizeof(uint8_t), n, fp) == n;
+    memcpy(hd.id, CACHEID, 8);
+    stat = stat && !fseek(fp, 0, SEEK_SET) && fwrite(&hd, sizeof(hd), 1, fp) == 1;
+    if (fclose(fp) || !stat) remove(path);
+}
+/* screen solutions by filter --------------------------------------------------
+* screen solutions solbuf[n0...] by filter in place
+*-----------------------------------------------------------------------------*/
+static void screensol(solbuf_t *solbuf, int n0, const solfilt_t *filt,
+    rdstat_t *rs)
+{
+    int i, j;
+
+    for (i = j = n0;i < solbuf->n;i++) {
+        if (!testfilt(filt, solbuf->t[i], solbuf->stat[i])) continue;
+        if (i > j) {
+            solbuf->t[j] = solbuf->t[i];
+            solbuf->pos[0][j] = solbuf->pos[0][i];
+            solbuf->pos[1][j] = solbuf->pos[1][i];
+            solbuf->pos[2][j] = solbuf->pos[2][i];
+            solbuf->stat[j] = solbuf->stat[i];
+            if (solbuf->ext) solbuf->ext[j] = solbuf->ext[i];
+        }
+        j++;
+    }
+    rs->nsol = j - n0;
+    rs->nscr += solbuf->n - j;
+    solbuf->n = j;
+}
+/* build time index ------------------------------------------------------------
+* build sparse time index of mapped solution file. an entry is added for the
+* first line with time field of every INDEXSTEP lines
+* args   : mapfile_t *map   I  memory mapped solution file
+*          solidx_t **idx   O  entries of time index (freed by caller)
+*          int    *sorted   O  solutions sorted by time (1:sorted,0:not)
+* return : number of entries (-1:error)
+* notes  : only the time field of each line is decoded
+*-----------------------------------------------------------------------------*/
+static int buildindex(const mapfile_t *map, solidx_t **idx, int *sorted)
+{
+    const char *p = map->data, *end = map->data + map->size, *q, *r;
+    solidx_t *ent = NULL, *tmp;
+    gtime_t time;
+    double val;
+    int64_t t, tp = INT64_MIN, line = 0, next = 0;
+    int n = 0, nmax = 0;
+
+    *sorted = 1;
+    for (;p < end;p = q + 1, line++) {
+        if (!(q = (const char *)memchr(p, '\n', end - p))) q = end;
+
+        for (r = p;r < q && (*r == ' ' || *r == '\t');r++) ;
+        if (r >= q || *r == COMMENTH[0] || !decode_num(r, q, &val)) continue;
+
+        time.time = (time_t)val;
+        time.sec = val - time.time;
+        t = time2tick(time);
+        if (t < tp) *sorted = 0;
+        tp = t;
+
+        if (line < next) continue;
+        if (n >= nmax) {
+            nmax = nmax == 0 ? 1024 : nmax * 2;
+            if (!(tmp = (solidx_t *)realloc(ent, sizeof(solidx_t)*nmax))) {
+                free(ent);
+                return -1;
+            }
+            ent = tmp;
+        }
+        ent[n].t = t;
+        ent[n].off = p - map->data;
+        ent[n++].line = line;
+        next = line + INDEXSTEP;
+    }
+    *idx = ent;
+    return n;
+}
+/* seek solution file by time index --------------------------------------------
+* seek range of lines in time window of filter by time index <file>.soli. the
+* index is read if it is valid for the file, otherwise it is built and written
+* args   : char   *file     I  solution file
+*          mapfile_t *map   I  memory mapped solution file
+*          solfilt_t *filt  I  solution filter
+*          mapfile_t *sub   O  range of lines (data and size)
+*          int    *line     O  number of lines before range
+* return : status (1:range set,0:no valid index or not sorted)
+* notes  : the range is found by binary search of entries, so a window of a
+*          long file is read in O(log n) plus the lines of the window. used
+*          only for files sorted by time
+*-----------------------------------------------------------------------------*/
+static int seekindex(const char *file, const mapfile_t *map,
+    const solfilt_t *filt, mapfile_t *sub, int *line)
+{
+    mapfile_t imap = { 0 };
+    solcache_t src, hd;
+    solidx_t *idx = NULL;
+    const solidx_t *ent;
+    FILE *fp;
+    char path[1024];
+    int64_t s, e;
+    int i, j, k, n, sorted;
+
+    if (!srcinfo(file, &src)) return 0;
+    memcpy(src.id, INDEXID, 8);
+
+    sprintf(path, "%.1018s%s", file, INDEXEXT);
+    if (openmap(path, &imap)) {
+        if (imap.size >= sizeof(solcache_t)) {
+            memcpy(&hd, imap.data, sizeof(solcache_t));
+        }
+        if (imap.size < sizeof(solcache_t) || memcmp(hd.id, src.id, 8) ||
+            hd.ver != src.ver || hd.bom != src.bom || hd.size != src.size ||
+            hd.mtime != src.mtime || hd.hash != src.hash || hd.n < 0 ||
+            imap.size != sizeof(solcache_t) + (uint64_t)hd.n * sizeof(solidx_t)) {
+            closemap(&imap);
+        }
+    }
+    if (imap.data) { /* valid index */
+        ent = (const solidx_t *)(imap.data + sizeof(solcache_t));
+        n = (int)hd.n;
+        sorted = hd.flag & 1;
+    }
+    else { /* build and write index */
+        if ((n = buildindex(map, &idx, &sorted)) < 0) return 0;
+        ent = idx;
+        src.n = n;
+        src.flag = sorted;
+        if ((fp = fopen(path, "wb"))) {
+            memset(src.id, 0, 8);
+            k = fwrite(&src, sizeof(src), 1, fp) == 1 &&
+                fwrite(idx, sizeof(solidx_t), n, fp) == (size_t)n;
+            memcpy(src.id, INDEXID, 8);
+            k = k && !fseek(fp, 0, SEEK_SET) && fwrite(&src, sizeof(src), 1, fp) == 1;
+            if (fclose(fp) || !k) remove(path);
+        }
+    }
+    if (sorted && n > 0) {
+        /* last entry before ts and first entry at or after te */
+        for (i = 0, j = n;i < j;) {
+            k = (i + j) / 2;
+            if (ent[k].t < filt->ts) i = k + 1; else j = k;
+        }
+        s = i > 0 ? ent[i - 1].off : 0;
+        *line = i > 0 ? (int)ent[i - 1].line : 0;
+        for (j = n;i < j;) {
+            k = (i + j) / 2;
+            if (ent[k].t < filt->te) i = k + 1; else j = k;
+        }
+        e = i < n ? ent[i].off : (int64_t)map->size;
+
+        sub->data = map->data + s;
+        sub->size = (size_t)(e - s);
+    }
+    free(idx);
+    closemap(&imap);
+    return sorted && n > 0;
+}
+/* read solution file -----------------------------------------------------------
+* read solution file into solution buffer (or pass to callback of reader)
+* return : status (1:ok,0:file open error,-1:memory allocation error)
+*-----------------------------------------------------------------------------*/
+static int readsolfile(const char *file, const solfilt_t *filt,
+    const rdopt_t *ropt, rdstat_t *rs, solbuf_t *solbuf)
+{
+    FILE *fp;
+    mapfile_t map, sub;
+    solopt_t opt = solopt_default;
+    solcache_t src;
+    solfilt_t all;
+    gtime_t t0 = { 0 };
+    const solfilt_t *sfilt = filt;
+    int64_t s, e;
+    int n0 = solbuf->n, cache = 0, summ = solbuf->summ;
+
+    if (summ) sumsolbuf(solbuf);
+
+    /* read solutions from cache or parse all solutions to build cache */
+    if (ropt->cache && !rs->range && srcinfo(file, &src)) {
+        if (readcache(file, &src, filt, rs, solbuf)) {
+            if (rs->nerr > 0) {
+                fprintf(stderr, "%s: %d invalid solution line(s) (first at line %d)\n",
+                        file, rs->nerr, rs->lerr);
+            }
+            if (summ) sumsolbuf(solbuf);
+            return 1;
+        }
+        if (!rs->func) {
+            initfilt(&all, t0, t0, 0.0, 0);
+            sfilt = &all;
+            cache = 1;
+            solbuf->summ = 0; /* summed after screened */
+        }
+    }
+
+    /* read solution data from memory mapped file */
+    if (ropt->mmap && openmap(file, &map)) {
+        sub = map;
+
+        /* complete lines in range of file */
+        if (rs->range) {
+            s = rs->range[0] < (int64_t)map.size ? rs->range[0] : (int64_t)map.size;
+            e = rs->range[1] > 0 && rs->range[1] < (int64_t)map.size ?
+                rs->range[1] : (int64_t)map.size;
+            while (e > s && map.data[e - 1] != '\n') e--;
+            sub.data = map.data + s;
+            sub.size = (size_t)(e > s ? e - s : 0);
+            rs->range[1] = s + (int64_t)sub.size;
+        }
+        /* seek time window by time index */
+        else if (ropt->index && (sfilt->ts != INT64_MIN || sfilt->te != INT64_MAX)) {
+            seekindex(file, &map, sfilt, &sub, &rs->line);
+        }
+        readsolmap(&sub, sfilt, &opt, rs->func ? 1 : ropt->nthread, rs,
+                   ropt->rdbuf, solbuf);
+        rs->byte += sub.size;
+        closemap(&map);
+    }
+    else {
+        if (!(fp = fopen(file, "rb"))) {
+           // trace(2, "readsolt: file open error %s\n", file);
+            return 0;
+        }
+        /* read solution options in header */
+       // readsolopt(fp, &opt);
+        rewind(fp);
 
+        /* read solution data (complete lines in range of file) */
+        if (rs->range) {
+            fseekoff(fp, 0, SEEK_END);
+            s = ftelloff(fp);
+            if (rs->range[0] < s) s = rs->range[0];
+            fseekoff(fp, s, SEEK_SET);
+            e = rs->range[1] <= 0 ? INT64_MAX : (rs->range[1] > s ?
+                rs->range[1] - s : 0);
+            rs->range[1] = s + readsoldata(fp, e, sfilt, &opt, rs, ropt->rdbuf,
+                                           solbuf);
+            rs->byte += (uint64_t)(rs->range[1] - s);
+        }
+        else {
+            rs->byte += (uint64_t)readsoldata(fp, -1, sfilt, &opt, rs,
+                                              ropt->rdbuf, solbuf);
+        }
+        fclose(fp);
+    }
+    if (rs->merr) {
+        fprintf(stderr, "%s: solution memory allocation error\n", file);
+        return -1;
+    }
+    if (cache) {
+        writecache(file, &src, solbuf, n0, rs);
+        screensol(solbuf, n0, filt, rs);
+        solbuf->summ = summ;
+    }
+    if (summ) sumsolbuf(solbuf);
+    if (rs->nerr > 0) {
+        fprintf(stderr, "%s: %d invalid solution line(s) (first at line %d)\n",
+                file, rs->nerr, rs->lerr);
+    }
+    return 1;
+}
+/* add statistics of reading ---------------------------------------------------
+* add counters of line reader status of a file to statistics
+*-----------------------------------------------------------------------------*/
+static void addstat(convstat_t *st, const rdstat_t *rs)
+{
+    st->bytein += rs->byte;
+    st->nline += rs->line;
+    st->nsol += rs->nsol;
+    st->nscr += rs->nscr;
+    st->nerr += rs->nerr;
+}
 /* read solutions data from solution files -------------------------------------
 * read solution data from soluiton files
 * args   : char   *files[]  I  solution files
@@ -403,36 +1773,148 @@ extern void freesolbuf(solbuf_t *solbuf)
 *         (gtime_t te)      I  end time   (te.time==0: to end)
 *         (double tint)     I  time interval (0: all)
 *         (int    qflag)    I  quality flag  (0: all)
+*          rdopt_t *ropt    I  read options (NULL: rdopt_default)
 *          solbuf_t *solbuf O  solution buffer
-* return : status (1:ok,0:no data or error)
+* return : status (1:ok,0:no data,-1:read error)
+* notes  : solutions of all files are sorted by time, see sort_solbuf()
+*          if ropt->arena is set and not in use, the columns are stored in the
+*          arena until freesolbuf(), see initsolarena()
+*          if ropt->cache is set, solutions are read from cache <file>.solc
+*          if it is valid for the file, otherwise all solutions of the file are
+*          parsed, written to the cache and then screened
+*          if ropt->index is set and time window is given, only the lines in
+*          the window are read by time index <file>.soli, see seekindex()
+*          if ropt->stat is set, the statistics of reading and sorting are
+*          added to it, see addstat()
+*          if ropt->mean is set, the positions are summed while read and
+*          solmean() returns the mean position without another pass
+*          if ropt->rdbuf is set, solbuf has to be initialized by initsolbuf()
+*          before the first read. the solutions are cleared by clearsolbuf()
+*          and the columns and the buffers of reader are reused
 *-----------------------------------------------------------------------------*/
-extern int readsolt(char *files, int nfile, gtime_t ts, gtime_t te,
-    double tint, int qflag, solbuf_t *solbuf)
+extern int readsoltx(char *files[], int nfile, gtime_t ts, gtime_t te,
+    double tint, int qflag, const rdopt_t *ropt, solbuf_t *solbuf)
 {
-    FILE *fp;
-    solopt_t opt = solopt_default;
-    int i;
+    convstat_t *st;
+    rdstat_t rs;
+    solfilt_t filt;
+    double t0[2], t1[2], t2[2], mem;
+    int i, stat, *seg;
 
     //trace(3, "readsolt: nfile=%d\n", nfile);
 
-    initsolbuf(solbuf, 0, 0);
+    if (!ropt) ropt = &rdopt_default;
+    if ((st = ropt->stat)) proctime(t0);
+
+    initfilt(&filt, ts, te, tint, qflag);
+
+    if (ropt->rdbuf) clearsolbuf(solbuf);
+    else initsolbuf(solbuf, 0, 0);
+
+    /* columns in arena (if no columns kept) */
+    if (ropt->arena && !ropt->arena->inuse && !solbuf->nmax) {
+        ropt->arena->inuse = 1;
+        solbuf->arena = ropt->arena;
+    }
+    solbuf->summ = ropt->mean;
+
+    if (!(seg = (int *)malloc(sizeof(int)*(nfile + 1)))) return 0;
 
     for (i = 0;i<nfile;i++) {
-        if (!(fp = fopen(files, "rb"))) {
-           // trace(2, "readsolt: file open error %s\n", files[i]);
-            continue;
+        memset(&rs, 0, sizeof(rs));
+        seg[i] = solbuf->n;
+        stat = readsolfile(files[i], &filt, ropt, &rs, solbuf);
+        if (st) addstat(st, &rs);
+        if (stat < 0) { /* no truncated solutions returned */
+            free(seg);
+            freesolbuf(solbuf);
+            return -1;
         }
-        /* read solution options in header */
-       // readsolopt(fp, &opt);
-        rewind(fp);
+    }
+    seg[nfile] = solbuf->n;
+    if (st) {
+        proctime(t1);
+        mem = (double)solbufmem(solbuf);
+        if (mem > st->memcol) st->memcol = mem;
+        st->ngrow += solbuf->ngrow;
+    }
+    stat = sort_solbuf(solbuf, seg, nfile);
+    free(seg);
 
-        /* read solution data */
-        if (!readsoldata(fp, ts, te, tint, qflag, &opt, solbuf)) {
-          //  trace(2, "readsolt: no solution in %s\n", files[i]);
-        }
-        fclose(fp);
+    if (st) {
+        proctime(t2);
+        st->wall[STG_READ] += t1[0] - t0[0];
+        st->cpu [STG_READ] += t1[1] - t0[1];
+        st->wall[STG_SORT] += t2[0] - t1[0];
+        st->cpu [STG_SORT] += t2[1] - t1[1];
+    }
+    return stat;
+}
+extern int readsolt(char *files[], int nfile, gtime_t ts, gtime_t te,
+    double tint, int qflag, solbuf_t *solbuf)
+{
+    return readsoltx(files, nfile, ts, te, tint, qflag, NULL, solbuf) > 0;
+}
+/* read solutions data by callback ---------------------------------------------
+* read solution data from solution file and pass each solution to callback
+* function in order of file without solution buffer
+* args   : char   *file     I  solution file
+*          gtime_t ts,te    I  start/end time (time==0: no screening)
+*          double tint      I  time interval (0: all)
+*          int    qflag     I  quality flag  (0: all)
+*          rdopt_t *ropt    I  read options (NULL: rdopt_default)
+*          int    (*func)() I  callback function (return 0 to stop reading)
+*          void   *arg      I  argument of callback function
+* return : number of solutions passed to callback (-1: file open error)
+* notes  : memory use is constant. the file is parsed by single thread
+*-----------------------------------------------------------------------------*/
+extern int readsolcb(char *file, gtime_t ts, gtime_t te, double tint,
+    int qflag, const rdopt_t *ropt, int (*func)(const sol_t *, void *),
+    void *arg)
+{
+    return readsolcbx(file, NULL, NULL, ts, te, tint, qflag, ropt, func, arg);
+}
+/* read solutions data in range of file by callback ----------------------------
+* read solution data in range of solution file and pass each solution to
+* callback function, as readsolcb()
+* args   : char   *file     I  solution file
+*          int64_t *range   IO range of file {start,end} (bytes) (NULL: all)
+*                              (end<=0: to end of file)
+*          int    *line     IO number of lines before range (in) and to end of
+*                              range read (out) (NULL: 0)
+*          ...                 (same as readsolcb())
+* return : number of solutions passed to callback (-1: file open error)
+* notes  : only complete lines terminated by "\n" in the range are read and
+*          range[1] is set to the end of the last complete line, so the lines
+*          appended to a growing file are read by next call from range[1]
+*          (if the file is not memory mapped, the lines to end of file).
+*          invalid lines are reported by line number counted from *line
+*-----------------------------------------------------------------------------*/
+extern int readsolcbx(char *file, int64_t *range, int *line, gtime_t ts,
+    gtime_t te, double tint, int qflag, const rdopt_t *ropt,
+    int (*func)(const sol_t *, void *), void *arg)
+{
+    solbuf_t solbuf;
+    rdstat_t rs;
+    solfilt_t filt;
+
+    if (!ropt) ropt = &rdopt_default;
+
+    initfilt(&filt, ts, te, tint, qflag);
+    initsolbuf(&solbuf, 0, 0);
+    memset(&rs, 0, sizeof(rs));
+    rs.func = func;
+    rs.arg = arg;
+    rs.range = range;
+    rs.line = line ? *line : 0;
+
+    if (readsolfile(file, &filt, ropt, &rs, &solbuf) <= 0) return -1;
+    if (line) {
+        rs.line -= *line; /* lines read for statistics */
+        *line += rs.line;
     }
-    return sort_solbuf(solbuf);
+    if (ropt->stat) addstat(ropt->stat, &rs);
+    return rs.nsol;
 }
 //extern int readsol(char *files[], int nfile, solbuf_t *sol)
 //{
@@ -448,15 +1930,40 @@ extern int readsolt(char *files, int nfile, gtime_t ts, gtime_t te,
 * args   : solbuf_t *solbuf I  solution buffer
 *          int    index     I  index of solution (0...)
 * return : solution data pointer (NULL: no solution, out of range)
+* notes  : the solution is assembled from the columns into solbuf->sol, so
+*          the pointer is valid until the next call of getsol()
+*          the position is returned as geodetic (sol->type=2) as stored
 *-----------------------------------------------------------------------------*/
 extern sol_t *getsol(solbuf_t *solbuf, int index)
 {
+    sol_t *sol = &solbuf->sol;
+    const solext_t *ext;
+    int i;
+
     //trace(4, "getsol: index=%d\n", index);
 
     if (index<0 || solbuf->n <= index) return NULL;
     if ((index = solbuf->start + index) >= solbuf->nmax) {
         index -= solbuf->nmax;
     }
-    return solbuf->data + index;
-}
+    memset(sol, 0, sizeof(sol_t));
+    sol->time = tick2time(solbuf->t[index]);
+    for (i = 0;i < 3;i++) sol->rr[i] = solbuf->pos[i][index];
+    sol->type = 2;
+    sol->stat = solbuf->stat[index];
 
+    if ((ext = solbuf->ext ? solbuf->ext + index : NULL)) {
+        for (i = 0;i < 3;i++) sol->rr[i + 3] = ext->rr[i];
+        for (i = 0;i < 6;i++) {
+            sol->qr[i] = ext->qr[i];
+            sol->qv[i] = ext->qv[i];
+            sol->dtr[i] = ext->dtr[i];
+        }
+        if (ext->type == 1) sol->type = 1;
+        sol->ns = ext->ns;
+        sol->age = ext->age;
+        sol->ratio = ext->ratio;
+        sol->thres = ext->thres;
+    }
+    return sol;
+}
@@ -0,0 +1,341 @@
+/*------------------------------------------------------------------------------
+* testkmz.cpp : test of kmz output with tiled points
+*
+* notes  : a synthetic solution file is converted to kml and to kmz with tiled
+*          points. the kmz is opened as zip archive, doc.kml is inflated and
+*          checked by crc-32 and size, and compared with the kml converted
+*          with same options. then every network link of doc.kml is resolved
+*          from the root of the archive, as by google earth, and the linked
+*          tiles and the tiles linked by them are opened. build and run from
+*          the top directory as:
+*
+*              g++ -O2 -Iinclude test/testkmz.cpp src/common.cpp src/solution.cpp \
+*                  src/kmz.cpp src/convKml.cpp -o testkmz -lpthread
+*              ./testkmz
+*
+*          the inflater supports stored and fixed huffman blocks only, written
+*          by the kmz writer. the exit status is 1 if a check fails
+*-----------------------------------------------------------------------------*/
+#include "../include/convKml.h"
+
+#define NSOL        20000               /* number of synthetic solutions */
+#define MAXLEVEL    3                   /* max level of quadtree of tiles */
+#define MAXTILE     1024                /* max number of tiles checked */
+#define INFILE      "testkmz.pos"       /* synthetic solution file */
+#define KMLBASE     "testkmz_l"         /* base name of kml output */
+#define KMZBASE     "testkmz_z"         /* base name of kmz output */
+
+typedef struct {        /* bit reader of deflate data */
+    const uint8_t *p;   /* data */
+    int n,i;            /* length and index of next byte */
+    uint32_t bitbuf;    /* bit buffer */
+    int nbit;           /* number of bits in bit buffer */
+    int err;            /* error (0:no,1:yes) */
+} bitrd_t;
+
+static const int lbase[]={ /* base of length codes 257-285 */
+    3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,
+    195,227,258
+};
+static const int lext[]={ /* extra bits of length codes 257-285 */
+    0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0
+};
+static const int dbase[]={ /* base of distance codes 0-29 */
+    1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,
+    3073,4097,6145,8193,12289,16385,24577
+};
+static const int dext[]={ /* extra bits of distance codes 0-29 */
+    0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13
+};
+static char *tiles[MAXTILE];            /* tiles opened */
+static int ntile=0;
+
+/* generate synthetic solution file ------------------------------------------*/
+static int genpos(const char *file)
+{
+    FILE *fp;
+    double lat=30.5,lon=114.3,h=25.0;
+    uint32_t seed=1;
+    int i;
+
+    if (!(fp=fopen(file,"w"))) return 0;
+    for (i=0;i<NSOL;i++) { /* random walk of ~1 km */
+        seed=seed*1103515245u+12345u;
+        lat+=((seed>>16)%201-100)*1E-7;
+        seed=seed*1103515245u+12345u;
+        lon+=((seed>>16)%201-100)*1E-7;
+        fprintf(fp,"%.3f  %.9f  %.9f  %.4f  %.4f  %.4f  %.4f  %3d %.1f\n",
+                1610600000.0+i*0.1,lat,lon,h,0.01,0.01,0.02,i%7?1:2,1.2);
+    }
+    fclose(fp);
+    return 1;
+}
+/* read file to memory -------------------------------------------------------*/
+static uint8_t *readfile(const char *file, int *n)
+{
+    FILE *fp;
+    uint8_t *buff;
+    long size;
+
+    if (!(fp=fopen(file,"rb"))) return NULL;
+    fseek(fp,0,SEEK_END);
+    size=ftell(fp);
+    fseek(fp,0,SEEK_SET);
+    if (size<0||!(buff=(uint8_t *)malloc(size+1))) {
+        fclose(fp);
+        return NULL;
+    }
+    *n=(int)fread(buff,1,size,fp);
+    buff[*n]='\0';
+    fclose(fp);
+    return buff;
+}
+/* get little-endian integers ------------------------------------------------*/
+static uint32_t getu2(const uint8_t *p)
+{
+    return (uint32_t)p[0]|(uint32_t)p[1]<<8;
+}
+static uint32_t getu4(const uint8_t *p)
+{
+    return getu2(p)|getu2(p+2)<<16;
+}
+/* crc-32 (bitwise) ----------------------------------------------------------*/
+static uint32_t crc32b(const uint8_t *buff, int len)
+{
+    uint32_t crc=0xFFFFFFFF;
+    int i,j;
+
+    for (i=0;i<len;i++) {
+        crc^=buff[i];
+        for (j=0;j<8;j++) crc=crc&1?(crc>>1)^0xEDB88320:crc>>1;
+    }
+    return ~crc;
+}
+/* get bits of deflate data (lsb first) --------------------------------------*/
+static uint32_t getbits(bitrd_t *br, int len)
+{
+    uint32_t val;
+
+    while (br->nbit<len) {
+        if (br->i>=br->n) {
+            br->err=1;
+            return 0;
+        }
+        br->bitbuf|=(uint32_t)br->p[br->i++]<<br->nbit;
+        br->nbit+=8;
+    }
+    val=br->bitbuf&((1u<<len)-1);
+    br->bitbuf>>=len;
+    br->nbit-=len;
+    return val;
+}
+/* get huffman code (msb first) ----------------------------------------------*/
+static uint32_t getcode(bitrd_t *br, int len)
+{
+    uint32_t code=0;
+    int i;
+
+    for (i=0;i<len;i++) code=code<<1|getbits(br,1);
+    return code;
+}
+/* decode fixed huffman literal/length symbol --------------------------------*/
+static int getsym(bitrd_t *br)
+{
+    uint32_t code=getcode(br,7);
+
+    if (code<=0x17) return 256+(int)code;
+    code=code<<1|getbits(br,1);
+    if (code>=0x30&&code<=0xBF) return (int)code-0x30;
+    if (code>=0xC0&&code<=0xC7) return 280+(int)code-0xC0;
+    code=code<<1|getbits(br,1);
+    return 144+(int)code-0x190;
+}
+/* inflate deflate data (stored and fixed huffman blocks) --------------------*/
+static int inflate(const uint8_t *data, int n, uint8_t *out, int nmax)
+{
+    bitrd_t br={data,n,0,0,0,0};
+    uint32_t final,type,len,nlen;
+    int m=0,sym,c,dist,i;
+
+    do {
+        final=getbits(&br,1);
+        type=getbits(&br,2);
+        if (type==0) { /* stored */
+            br.bitbuf=0; br.nbit=0;
+            if (br.i+4>n) return -1;
+            len=getu2(data+br.i); nlen=getu2(data+br.i+2);
+            br.i+=4;
+            if ((len^0xFFFF)!=nlen||br.i+(int)len>n||m+(int)len>nmax) return -1;
+            memcpy(out+m,data+br.i,len);
+            br.i+=len; m+=len;
+        }
+        else if (type==1) { /* fixed huffman */
+            while ((sym=getsym(&br))!=256&&!br.err) {
+                if (sym<256) {
+                    if (m>=nmax) return -1;
+                    out[m++]=(uint8_t)sym;
+                    continue;
+                }
+                if ((c=sym-257)>=29) return -1;
+                len=lbase[c]+getbits(&br,lext[c]);
+                if ((c=(int)getcode(&br,5))>=30) return -1;
+                dist=dbase[c]+getbits(&br,dext[c]);
+                if (dist>m||m+(int)len>nmax) return -1;
+                for (i=0;i<(int)len;i++,m++) out[m]=out[m-dist];
+            }
+        }
+        else return -1; /* dynamic huffman not written by kmz writer */
+
+        if (br.err) return -1;
+    } while (!final);
+
+    return m;
+}
+/* extract doc.kml from kmz --------------------------------------------------*/
+static uint8_t *readkmz(const char *file, int *n)
+{
+    uint8_t *zip,*cd,*data,*kml;
+    uint32_t crc,csize,usize;
+    int nzip;
+
+    if (!(zip=readfile(file,&nzip))) {
+        printf("kmz open error: %s\n",file);
+        return NULL;
+    }
+    cd=zip+nzip-22-46-7; /* single entry "doc.kml" */
+    if (nzip<30+7+16+46+7+22||getu4(zip)!=0x04034B50||
+        getu4(cd)!=0x02014B50||getu4(zip+nzip-22)!=0x06054B50||
+        getu2(cd+28)!=7||memcmp(cd+46,"doc.kml",7)) {
+        printf("kmz archive error: %s\n",file);
+        free(zip);
+        return NULL;
+    }
+    crc=getu4(cd+16); csize=getu4(cd+20); usize=getu4(cd+24);
+    data=zip+30+getu2(zip+26)+getu2(zip+28);
+
+    if (data+csize>zip+nzip||!(kml=(uint8_t *)malloc(usize+1))||
+        (*n=inflate(data,(int)csize,kml,(int)usize))!=(int)usize||
+        crc32b(kml,*n)!=crc) {
+        printf("kmz inflate error: %s\n",file);
+        free(zip);
+        return NULL;
+    }
+    kml[*n]='\0';
+    free(zip);
+    return kml;
+}
+/* check network links of kml --------------------------------------------------
+* open the files linked by network links of kml and the files linked by them
+* args   : char   *kml      I   kml text
+*          int    root      I   kml is doc.kml in kmz (0:no,1:yes)
+* return : status (1:ok,0:error)
+* notes  : the kmz and the tiles are in current directory. a link from doc.kml
+*          is resolved from the root of the archive, so it has to be "../"
+*          to refer a file next to the kmz
+*-----------------------------------------------------------------------------*/
+static int chklinks(const char *kml, int root)
+{
+    const char *p=kml,*q;
+    char href[256],*path=href,*buff;
+    int i,n,ok=1;
+
+    while ((p=strstr(p,"<Link><href>"))&&(q=strstr(p,"</href>"))) {
+        p+=12;
+        sprintf(href,"%.*s",(int)(q-p<255?q-p:255),p);
+        p=q;
+        if (root) {
+            if (strncmp(href,"../",3)) {
+                printf("link in archive not found: %s\n",href);
+                return 0;
+            }
+            path=href+3;
+        }
+        else if (strchr(href,'/')) {
+            printf("link out of directory: %s\n",href);
+            return 0;
+        }
+
+        for (i=0;i<ntile;i++) if (!strcmp(tiles[i],path)) break;
+        if (i<ntile) continue;
+
+        if (!(buff=(char *)readfile(path,&n))) {
+            printf("link open error: %s -> %s\n",href,path);
+            return 0;
+        }
+        if (ntile<MAXTILE) tiles[ntile++]=strdup(path);
+        if (n<7||strcmp(buff+n-7,"</kml>\n")) {
+            printf("tile not complete: %s\n",path);
+            ok=0;
+        }
+        else ok&=chklinks(buff,0);
+        free(buff);
+        if (!ok) return 0;
+    }
+    return ok;
+}
+/* replace string ------------------------------------------------------------*/
+static void replace(char *str, const char *s1, const char *s2)
+{
+    char *p=str;
+    int n1=(int)strlen(s1),n2=(int)strlen(s2);
+
+    while ((p=strstr(p,s1))) {
+        memmove(p+n2,p+n1,strlen(p+n1)+1);
+        memcpy(p,s2,n2);
+        p+=n2;
+    }
+}
+/* main ----------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    kmlopt_t opt=kmlopt_default;
+    char *infile[]={(char *)INFILE};
+    char *kmlfile[]={(char *)KMLBASE ".kml"},*kmzfile[]={(char *)KMZBASE ".kmz"};
+    char *kml,*doc;
+    int i,n,nkml,ok=1;
+
+    if (!genpos(INFILE)) {
+        printf("file write error: %s\n",INFILE);
+        return 1;
+    }
+    opt.tile=MAXLEVEL;
+    opt.outtime=0;
+    if (convkmlx(infile,kmlfile,1,&opt,NULL)) ok=0;
+    opt.kmz=1;
+    if (convkmlx(infile,kmzfile,1,&opt,NULL)) ok=0;
+    printf("%-12s %s\n","convert",ok?"ok":"NG");
+
+    if (ok&&(doc=(char *)readkmz(kmzfile[0],&n))) {
+
+        /* doc.kml same as kml except links */
+        kml=(char *)readfile(kmlfile[0],&nkml);
+        replace(doc,"../" KMZBASE "_",KMLBASE "_");
+        i=kml&&!strcmp(doc,kml);
+        printf("%-12s %s\n","doc.kml",i?"ok":"NG");
+        ok&=i;
+        free(kml);
+        free(doc);
+
+        /* links from root of archive */
+        if (!(doc=(char *)readkmz(kmzfile[0],&n))) ok=0;
+        else {
+            i=chklinks(doc,1)&&ntile>1;
+            printf("%-12s %s (%d tiles opened)\n","links",i?"ok":"NG",ntile);
+            ok&=i;
+            free(doc);
+        }
+    }
+    else ok=0;
+
+    remove(INFILE);
+    for (i=0;i<ntile;i++) {
+        remove(tiles[i]);
+        replace(tiles[i],KMZBASE "_",KMLBASE "_");
+        remove(tiles[i]);
+        free(tiles[i]);
+    }
+    remove(kmlfile[0]);
+    remove(kmzfile[0]);
+    printf("%s\n",ok?"all ok":"error");
+    return ok?0:1;
+}
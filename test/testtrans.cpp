@@ -0,0 +1,161 @@
+/*------------------------------------------------------------------------------
+* testtrans.cpp : accuracy test of batch coordinate transformations
+*
+* notes  : the batch transformations (pos2ecefv(),ecef2posv(),enu2ecefv(),
+*          ecef2enuv()) are compared with the scalar transformations over a
+*          grid of latitude/longitude/height including the poles and the
+*          positions near the geocenter transformed by ecef2pos() in
+*          ecef2posv(). build and run from the top directory as:
+*
+*              g++ -O2 -Iinclude test/testtrans.cpp src/common.cpp -o testtrans
+*              ./testtrans
+*
+*          the max error of each transformation is printed and the exit
+*          status is 1 if an error exceeds the tolerance. the tolerance of
+*          ecef2posv() is 1E-5 m, 1/10 of the resolution of kml coordinates
+*          (1E-9 deg), since the iteration of ecef2pos() stops at 1E-4 m
+*          and the closed form may differ by the last digit of output.
+*          the kernels are compared without fma contraction by -O2. with
+*          -march=native they may differ by rounding (under 1E-9 m)
+*-----------------------------------------------------------------------------*/
+#include <cmath>
+#include "../include/common.h"
+
+#define TOLECEF     1E-6                /* tolerance of ecef position (m) */
+#define TOLPOS      1E-5                /* tolerance of geodetic position (m) */
+#define TOLENU      1E-9                /* tolerance of local vector (m) */
+#define RGEOC       1E5                 /* radius of fallback to ecef2pos() (m) */
+#define MAXPOS      (64*1024)           /* max number of test positions */
+
+static const double lats[]={ /* latitudes of grid (deg) */
+    -90.0,-90.0+1E-9,-89.9999,-89.0,-75.0,-60.0,-45.0,-30.0,-15.0,-1E-9,0.0,
+    1E-9,15.0,30.0,35.6,45.0,60.0,75.0,89.0,89.9999,90.0-1E-9,90.0
+};
+static const double lons[]={ /* longitudes of grid (deg) */
+    -180.0,-135.0,-90.0,-45.0,-1E-9,0.0,30.0,90.0,114.3,135.0,179.9999,180.0
+};
+static const double hgts[]={ /* heights of grid (m) */
+    -6300000.0,-6000000.0,-1000.0,-100.0,0.0,0.001,100.0,8848.0,4E5,2E7,
+    3.6E7
+};
+static const double vecs[][3]={ /* local vectors {e,n,u} (m) */
+    {0.0,0.0,0.0},{1.0,0.0,0.0},{0.0,1.0,0.0},{0.0,0.0,1.0},{3.5,-2.0,10.0},
+    {-1000.0,500.0,-20.0}
+};
+/* distance between geodetic positions in ecef (m) ---------------------------*/
+static double posdist(const double *pos1, const double *pos2)
+{
+    double r1[3],r2[3],d[3];
+
+    pos2ecef(pos1,r1);
+    pos2ecef(pos2,r2);
+    d[0]=r1[0]-r2[0]; d[1]=r1[1]-r2[1]; d[2]=r1[2]-r2[2];
+    return norm(d,3);
+}
+/* check max error -----------------------------------------------------------*/
+static int chkerr(const char *name, double err, double tol)
+{
+    printf("%-12s max error %10.3E m (tolerance %8.1E m) %s\n",name,err,tol,
+           err<=tol?"ok":"NG");
+    return err<=tol;
+}
+/* test pos2ecefv() and ecef2posv() ------------------------------------------*/
+static int testpos(void)
+{
+    static double p[3][MAXPOS],r[3][MAXPOS],q[3][MAXPOS];
+    double *pp[3],*rr[3],*qq[3],pos[3],rs[3],ps[3],d[3],err[3]={0},e;
+    int i,j,k,n=0,ng,ok=1;
+
+    for (i=0;i<(int)(sizeof(lats)/sizeof(double));i++)
+    for (j=0;j<(int)(sizeof(lons)/sizeof(double));j++)
+    for (k=0;k<(int)(sizeof(hgts)/sizeof(double));k++) {
+        p[0][n]=lats[i]*D2R; p[1][n]=lons[j]*D2R; p[2][n]=hgts[k]; n++;
+    }
+    for (i=0;i<3;i++) {
+        pp[i]=p[i]; rr[i]=r[i]; qq[i]=q[i];
+    }
+    pos2ecefv(pp,rr,n);
+    ng=n;
+
+    /* near geocenter (fallback to ecef2pos()) */
+    for (i=0;i<64&&n<MAXPOS;i++,n++) {
+        e=RGEOC*(i+0.5)/64.0;
+        r[0][n]=e*cos(i*0.7)*cos(i*0.3);
+        r[1][n]=e*sin(i*0.7)*cos(i*0.3);
+        r[2][n]=e*sin(i*0.3);
+    }
+    r[0][n]=r[1][n]=r[2][n]=0.0; n++; /* geocenter */
+    ecef2posv(rr,qq,n);
+
+    for (i=0;i<n;i++) {
+        for (j=0;j<3;j++) {
+            pos[j]=p[j][i]; rs[j]=r[j][i];
+        }
+        if (i<ng) { /* pos2ecefv() for grid */
+            pos2ecef(pos,rs);
+            for (j=0;j<3;j++) d[j]=rs[j]-r[j][i];
+            if ((e=norm(d,3))>err[0]) err[0]=e;
+        }
+        for (j=0;j<3;j++) {
+            rs[j]=r[j][i]; pos[j]=q[j][i];
+        }
+        ecef2pos(rs,ps);
+        if (norm(rs,3)<RGEOC) { /* same as ecef2pos() near geocenter */
+            if (ps[0]!=pos[0]||ps[1]!=pos[1]||ps[2]!=pos[2]) err[2]=1.0;
+            continue;
+        }
+        if ((e=posdist(ps,pos))>err[1]) err[1]=e;
+    }
+    ok&=chkerr("pos2ecefv",err[0],TOLECEF);
+    ok&=chkerr("ecef2posv",err[1],TOLPOS);
+    ok&=chkerr("ecef2posv(<100km)",err[2],0.0);
+    return ok;
+}
+/* test enu2ecefv() and ecef2enuv() ------------------------------------------*/
+static int testenu(void)
+{
+    static double p[3][MAXPOS],e[3][MAXPOS],r[3][MAXPOS],u[3][MAXPOS];
+    double *pp[3],*ee[3],*rr[3],*uu[3],pos[3],ev[3],rs[3],us[3],E[9],d[3];
+    double err[2]={0},f;
+    int i,j,k,n=0,ok=1;
+
+    for (i=0;i<(int)(sizeof(lats)/sizeof(double));i++)
+    for (j=0;j<(int)(sizeof(lons)/sizeof(double));j++)
+    for (k=0;k<(int)(sizeof(vecs)/sizeof(vecs[0]));k++) {
+        p[0][n]=lats[i]*D2R; p[1][n]=lons[j]*D2R; p[2][n]=0.0;
+        e[0][n]=vecs[k][0]; e[1][n]=vecs[k][1]; e[2][n]=vecs[k][2]; n++;
+    }
+    for (i=0;i<3;i++) {
+        pp[i]=p[i]; ee[i]=e[i]; rr[i]=r[i]; uu[i]=u[i];
+    }
+    enu2ecefv(pp,ee,rr,n);
+    ecef2enuv(pp,rr,uu,n);
+
+    for (i=0;i<n;i++) {
+        for (j=0;j<3;j++) {
+            pos[j]=p[j][i]; ev[j]=e[j][i];
+        }
+        enu2ecef(pos,ev,rs);
+        for (j=0;j<3;j++) d[j]=rs[j]-r[j][i];
+        if ((f=norm(d,3))>err[0]) err[0]=f;
+
+        for (j=0;j<3;j++) rs[j]=r[j][i];
+        xyz2enu(pos,E);
+        matmul("NN",3,1,3,1.0,E,rs,0.0,us);
+        for (j=0;j<3;j++) d[j]=us[j]-u[j][i];
+        if ((f=norm(d,3))>err[1]) err[1]=f;
+    }
+    ok&=chkerr("enu2ecefv",err[0],TOLENU);
+    ok&=chkerr("ecef2enuv",err[1],TOLENU);
+    return ok;
+}
+/* main ----------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    int ok=1;
+
+    ok&=testpos();
+    ok&=testenu();
+    printf("%s\n",ok?"all ok":"error over tolerance");
+    return ok?0:1;
+}